@@ -0,0 +1,8 @@
+#version 460 core
+
+// A single triangle covering the screen, generated from the vertex index so that no vertex buffers are needed
+void main()
+{
+    vec2 position = vec2(float((gl_VertexID & 1) << 2) - 1.0, float((gl_VertexID & 2) << 1) - 1.0);
+    gl_Position = vec4(position, 0.0, 1.0);
+}
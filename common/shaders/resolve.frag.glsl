@@ -0,0 +1,53 @@
+#version 460 core
+
+// Resolve pass of the deferred texturing renderer: the visibility buffer says which instance covers each pixel, everything
+// needed to texture it is fetched from there, so texturing and shading run once per pixel however much overdraw there was
+
+struct SpriteInstance {
+    vec4 rows[3];   // Top three rows of the model matrix
+    vec2 layer;     // Layer and texture layer
+};
+
+layout (std140) uniform Matrices
+{
+	mat4 projection_view_matrix;
+	mat4 inverse_projection_view_matrix;
+};
+
+layout (std430, binding = 0) readonly buffer Instances
+{
+    SpriteInstance instances[];
+};
+
+uniform usampler2D visibility;
+uniform sampler2D visibility_depth;
+uniform sampler2DArray textures_albedo;
+uniform vec4 viewport; // The area of the framebuffer the visibility buffer covers: x, y, width, height
+
+out vec4 out_color;
+
+void main()
+{
+    ivec2 pixel = ivec2(gl_FragCoord.xy - viewport.xy);
+    uvec2 ids = texelFetch(visibility, pixel, 0).xy;
+    if (ids.x == 0u) {
+        discard;
+    }
+    SpriteInstance instance = instances[ids.x - 1u];
+
+    // Reconstruct the world position of the pixel from its depth
+    float depth = texelFetch(visibility_depth, pixel, 0).r;
+    vec4 clip = vec4((vec2(pixel) + 0.5) / viewport.zw * 2.0 - 1.0, depth * 2.0 - 1.0, 1.0);
+    vec4 world = inverse_projection_view_matrix * clip;
+    vec3 offset = world.xyz / world.w - vec3(instance.rows[0].w, instance.rows[1].w, instance.rows[2].w);
+
+    // Sprites are unit quads in their local xy plane: solve offset = x * column0 + y * column1 for the local position, by
+    // least squares so that a zero z scale doesn't make the model matrix singular
+    vec3 column0 = vec3(instance.rows[0].x, instance.rows[1].x, instance.rows[2].x);
+    vec3 column1 = vec3(instance.rows[0].y, instance.rows[1].y, instance.rows[2].y);
+    float c01 = dot(column0, column1);
+    mat2 normal = mat2(dot(column0, column0), c01, c01, dot(column1, column1));
+    vec2 local = inverse(normal) * vec2(dot(column0, offset), dot(column1, offset));
+
+    out_color = texture(textures_albedo, vec3(local + 0.5, instance.layer.y));
+}
@@ -0,0 +1,25 @@
+#version 460 core
+
+layout (location = 0) in vec3 in_position;
+// Per-instance attributes: the top three rows of the model matrix (see math::Matrix4x3), then the layer and texture layer
+layout (location = 1) in vec4 in_instance_row0;
+layout (location = 2) in vec4 in_instance_row1;
+layout (location = 3) in vec4 in_instance_row2;
+layout (location = 4) in vec2 in_instance_layer;
+
+layout (std140) uniform Matrices
+{
+	mat4 projection_view_matrix;
+	mat4 inverse_projection_view_matrix;
+};
+
+// Index of the instance in the instance buffer, for the visibility buffer
+flat out uint instance_id;
+
+void main()
+{
+    vec4 local_position = vec4(in_position, 1.0);
+    vec3 world_position = vec3(dot(in_instance_row0, local_position), dot(in_instance_row1, local_position), dot(in_instance_row2, local_position));
+    gl_Position = projection_view_matrix * vec4(world_position, 1.0);
+    instance_id = uint(gl_BaseInstance + gl_InstanceID);
+}
@@ -0,0 +1,11 @@
+#version 460 core
+
+flat in uint instance_id;
+
+// Instance plus one (0 is cleared to mean nothing was drawn) and triangle
+layout (location = 0) out uvec2 out_visibility;
+
+void main()
+{
+    out_visibility = uvec2(instance_id + 1u, uint(gl_PrimitiveID));
+}
@@ -27,7 +27,11 @@ bool core::readUserConfig (int argc, char* argv[])
         ("g,gamefiles", "Path(s) to game files", cxxopts::value<std::vector<std::string>>())
         ("m,modules", "Modules list file", cxxopts::value<std::string>())
         ("modulepath", "Path to Module files", cxxopts::value<std::string>())
-        ("i,init", "Initialisation file", cxxopts::value<std::string>()->default_value("init.toml"));
+        ("i,init", "Initialisation file", cxxopts::value<std::string>()->default_value("init.toml"))
+        ("headless", "Run without a window or renderer")
+        ("record", "Record the event stream to a file", cxxopts::value<std::string>())
+        ("replay", "Replay a recorded event stream", cxxopts::value<std::string>())
+        ("replay-timings", "Write per-frame timings of a replay to a CSV file", cxxopts::value<std::string>());
     auto result = options.parse(argc, argv);
 
     //******************************************************//
@@ -147,6 +151,15 @@ bool core::readUserConfig (int argc, char* argv[])
 #ifdef DEBUG_BUILD
         entt::monostate<"graphics/debug-rendering"_hs>{} = bool{result["debug"].count() > 0};
 #endif
+        // Headless mode runs the simulation only: no window, no GL context and no render thread
+        entt::monostate<"graphics/headless"_hs>{} = bool{result["headless"].count() > 0};
+
+        //******************************************************//
+        // RECORDING AND REPLAY
+        //******************************************************//
+        entt::monostate<"tools/record-file"_hs>{} = result["record"].count() > 0 ? result["record"].as<std::string>() : std::string{};
+        entt::monostate<"tools/replay-file"_hs>{} = result["replay"].count() > 0 ? result["replay"].as<std::string>() : std::string{};
+        entt::monostate<"tools/replay-timings-file"_hs>{} = result["replay-timings"].count() > 0 ? result["replay-timings"].as<std::string>() : std::string{};
 
         //******************************************************//
         // UI (imgui engine UI, not in-game UI)
@@ -215,6 +228,7 @@ bool core::readGameConfig () {
         entt::monostate<"graphics/opengl/double-buffered"_hs>{} = bool{true};
         entt::monostate<"graphics/renderer/near-distance"_hs>{} = 0.01f;
         entt::monostate<"graphics/renderer/far-distance"_hs>{} = 100.0f;
+        entt::monostate<"graphics/renderer/shader-cache"_hs>{} = std::string{"shader-cache"};
 
         // Overwrite with settings
         if (config.contains("graphics")) {
@@ -236,6 +250,7 @@ bool core::readGameConfig () {
                 const auto& renderer = graphics.at("renderer");
                 maybe_set<"graphics/renderer/near-distance"_hs, float>(renderer, "near-distance");
                 maybe_set<"graphics/renderer/far-distance"_hs, float>(renderer, "far-distance");
+                maybe_set<"graphics/renderer/shader-cache"_hs, std::string>(renderer, "shader-cache");
             }
         }
 
@@ -244,6 +259,7 @@ bool core::readGameConfig () {
         //******************************************************//
         // Default settings for [memory] section
         entt::monostate<"memory/events/pool-size"_hs>{} = std::uint32_t{96};
+        entt::monostate<"memory/timers/capacity"_hs>{} = std::uint32_t{16384};
 
         // Overwrite with settings
         if (config.contains("memory")) {
@@ -251,6 +267,9 @@ bool core::readGameConfig () {
             if (memory.contains("events")) {
                 maybe_set<"memory/events/pool-size"_hs, std::uint32_t>(memory.at("events"), "per-thread-pool-size");
             }
+            if (memory.contains("timers")) {
+                maybe_set<"memory/timers/capacity"_hs, std::uint32_t>(memory.at("timers"), "capacity");
+            }
         } else {
             
         }
@@ -279,6 +298,21 @@ bool core::readGameConfig () {
             entt::monostate<"physics/max-substeps"_hs>{} = int(5);
             entt::monostate<"physics/gravity"_hs>{} = glm::vec3{0, 0, 0};
         }
+
+        //******************************************************//
+        // SIMULATION
+        //******************************************************//
+        // Default to variable-tick mode, simulating once per rendered frame
+        entt::monostate<"simulation/tick-delta"_hs>{} = DeltaTime{0};
+        entt::monostate<"simulation/max-ticks-per-frame"_hs>{} = std::uint32_t{5};
+        if (config.contains("simulation")) {
+            const auto& simulation = config.at("simulation");
+            const double tick_rate = toml::find_or<double>(simulation, "tick-rate", 0.0);
+            if (tick_rate > 0) {
+                entt::monostate<"simulation/tick-delta"_hs>{} = DeltaTime(1.0 / tick_rate);
+            }
+            maybe_set<"simulation/max-ticks-per-frame"_hs, std::uint32_t>(simulation, "max-ticks-per-frame");
+        }
     } catch (const std::exception& e) {
         spdlog::critical("Could not load game config: {}", e.what());
         return false;
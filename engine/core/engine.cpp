@@ -18,16 +18,34 @@ int get_num_workers () {
     return max_workers > 1 ? max_workers - 1 : max_workers;
 }
 
-int get_global_event_pool_size () {
+// Number of event blocks needed for every thread to emit a full per-thread pool worth of events (workers plus the engine thread)
+std::uint32_t get_event_block_reserve () {
     const std::uint32_t pool_size = entt::monostate<"memory/events/pool-size"_hs>();
-    return pool_size * get_num_workers();
+    const std::uint32_t blocks_per_thread = (pool_size + core::Engine::EventBlockCapacity - 1) / core::Engine::EventBlockCapacity;
+    return blocks_per_thread * (get_num_workers() + 1);
 }
 
 core::Engine::Engine () :
     m_scene_manager(*this),
     m_executor(get_num_workers()),
-    m_event_pool(get_global_event_pool_size())
+    m_input_event_pool(m_event_blocks),
+    m_sorted_events(entt::monostate<"memory/events/pool-size"_hs>()),
+    m_timer_event_pool(m_event_blocks),
+    m_tick_delta(entt::monostate<"simulation/tick-delta"_hs>()),
+    m_max_ticks_per_frame(entt::monostate<"simulation/max-ticks-per-frame"_hs>())
 {
+    m_timing_epoch = Clock::now();
+    m_engine_thread = std::this_thread::get_id();
+    m_emitter_generation = nextEmitterGeneration();
+    for (std::size_t worker = 0; worker < m_executor.num_workers(); ++worker) {
+        m_system_timing_rings.push_back(std::make_unique<SystemTimingRing>());
+    }
+    for (auto& wheel : m_timer_wheels) {
+        wheel.reserve(entt::monostate<"memory/timers/capacity"_hs>());
+    }
+    // Pre-allocate event blocks for the common case, more will be allocated if a frame needs them
+    m_event_blocks.reserve(get_event_block_reserve());
+    m_event_blocks_reported = m_event_blocks.count();
     // Manage Named entities
     m_registry.on_construct<components::Named>().connect<&core::Engine::onAddNamedEntity>(this);
     m_registry.on_destroy<components::Named>().connect<&core::Engine::onRemoveNamedEntity>(this);
@@ -70,7 +88,61 @@ entt::registry& core::Engine::registry(gou::api::Registry which)
 
 entt::organizer& core::Engine::organizer(gou::api::SystemStage type)
 {
-    return m_organizers[type];
+    auto it = std::find_if(m_module_systems.begin(), m_module_systems.end(), [this](const auto& systems){ return systems.module == m_active_module; });
+    if (it == m_module_systems.end()) {
+        m_module_systems.push_back({m_active_module, {}});
+        it = m_module_systems.end() - 1;
+    }
+    // The organizer may be added to, so the stage must be rebuilt before the next frame
+    m_dirty_stages |= 1u << helpers::enum_value(type);
+    return it->organizers[type];
+}
+
+void core::Engine::beginModuleUpdate (gou::api::Module* mod)
+{
+    m_active_module = mod;
+    // Set the modules systems aside, so that if it reloads, only systems registered by its new code are kept
+    auto it = std::find_if(m_module_systems.begin(), m_module_systems.end(), [mod](const auto& systems){ return systems.module == mod; });
+    if (it != m_module_systems.end()) {
+        std::swap(m_stashed_organizers, it->organizers);
+    }
+}
+
+void core::Engine::endModuleUpdate (gou::api::Module* old_module, gou::api::Module* new_module, bool reloaded)
+{
+    m_active_module = nullptr;
+    auto it = std::find_if(m_module_systems.begin(), m_module_systems.end(), [old_module](const auto& systems){ return systems.module == old_module; });
+    if (it == m_module_systems.end()) {
+        m_stashed_organizers.clear();
+        return;
+    }
+    if (reloaded) {
+        // The old systems point at code that has been unloaded, rebuild every stage they were in
+        std::size_t old_systems = 0;
+        for (auto& [stage, organizer] : m_stashed_organizers) {
+            m_dirty_stages |= 1u << helpers::enum_value(stage);
+            old_systems += organizer.graph().size();
+        }
+        m_stashed_organizers.clear();
+        std::size_t new_systems = 0;
+        for (auto& [stage, organizer] : it->organizers) {
+            new_systems += organizer.graph().size();
+        }
+        if (new_systems == 0 && old_systems > 0) {
+            spdlog::warn("Module reloaded without registering its systems again, its {} systems were dropped (register them in onRegisterSystems)", old_systems);
+        }
+        it->module = new_module;
+        if (new_module != old_module) {
+            for (auto* hooks : {&m_hooks_beforeFrame, &m_hooks_afterFrame, &m_hooks_beforeUpdate, &m_hooks_loadScene, &m_hooks_unloadScene, &m_hooks_prepareRender, &m_hooks_beforeRender, &m_hooks_afterRender}) {
+                std::replace(hooks->begin(), hooks->end(), old_module, new_module);
+            }
+        }
+        spdlog::info("Module reloaded, rebuilding its systems ({} before, {} after)", old_systems, new_systems);
+    } else {
+        // Nothing reloaded, so the module kept its systems
+        std::swap(m_stashed_organizers, it->organizers);
+        m_stashed_organizers.clear();
+    }
 }
 
 entt::entity core::Engine::findEntity (entt::hashed_string name) const
@@ -128,20 +200,21 @@ void core::Engine::handleInput ()
      * Gather input from input devices: keyboard, mouse, gamepad, joystick
      * Input is mapped to events and those events are emitted for systems to process.
      * handleInput doesn't use the engines normal emit() API, instead it adds the events
-     * directly to the m_event_pool global event pool. This way, input-generated events
+     * directly to the m_input_event_pool, which is always readable. This way, input-generated events
      * are immediately available, without a frame-delay. We can do this, because handleInput
      * is guaranteed to be called serially, before the taskflow graph is executed, so we can
      * guarantee 
      */
 
     SDL_Event event;
+    bool exit_requested = false;
     m_input_events.clear();
     // Gather and dispatch input
     while (SDL_PollEvent(&event))
     {
         switch (event.type) {
             case SDL_QUIT:
-                internalEmplaceEvent("engine/exit"_event);
+                exit_requested = true;
                 break;
             case SDL_WINDOWEVENT:
             {
@@ -150,7 +223,7 @@ void core::Engine::handleInput ()
                 case SDL_WINDOWEVENT_SIZE_CHANGED:
                     entt::monostate<"graphics/resolution/width"_hs>{} = int(event.window.data1);
                     entt::monostate<"graphics/resolution/height"_hs>{} = int(event.window.data2);
-                    graphics::windowChanged(m_renderer);
+                    // The new size reaches the render thread with the next published render packet
                     break;
                 default:
                     break;
@@ -161,7 +234,7 @@ void core::Engine::handleInput ()
             case SDL_KEYUP:
             {
                 if (event.key.keysym.sym == SDLK_ESCAPE) {
-                    internalEmplaceEvent("engine/exit"_event);
+                    exit_requested = true;
                 } else {
                     // handleInput(engine, input_mapping, InputKeys::KeyType::KeyboardButton, event.key.keysym.scancode, [&event]() -> float {
                     //     return event.key.state == SDL_PRESSED ? 1.0f : 0.0f;
@@ -207,6 +280,17 @@ void core::Engine::handleInput ()
         m_input_events.push_back(event);
     }
 
+    if (m_replay) {
+        // When replaying, input comes from the recording rather than from the input devices. Input carried over from a frame without ticks
+        // stays, the recording only holds each frames new input
+        for (const auto& recorded : m_replay->inputEvents()) {
+            m_input_event_pool.emplace(recorded);
+        }
+    }
+    if (exit_requested) {
+        internalEmplaceEvent("engine/exit"_event);
+    }
+
     // Make sure that any events that were dispatched are visible to the engine
     refreshEventsIterator();
 }
@@ -214,116 +298,288 @@ void core::Engine::handleInput ()
 bool core::Engine::execute (Time current_time, DeltaTime delta, uint64_t frame_count)
 {
     EASY_FUNCTION(profiler::colors::Blue100);
-    m_current_time_delta = delta;
+    if (m_replay) {
+        // Replay the recorded frame timing, so that time-dependent logic behaves as it did during recording
+        if (! m_replay->next()) {
+            return false;
+        }
+        current_time = m_replay->frame().time;
+        delta = m_replay->frame().delta;
+        frame_count = m_replay->frame().frame;
+    }
+    m_current_frame = frame_count;
+
+    // Input events that no tick has pumped yet (the previous frame ran no ticks) are still readable and were already captured
+    const std::uint32_t carried_input_events = m_input_event_pool.count();
 
     // Read input device states and dispatch events. Input events are emitted directly into the global pool, immediately readable "this frame" (no frame delay!)
     handleInput();
 
-    // // Process previous frames events, looking for ones the core engine cares about
-    // Yes, its a bit wasteful to loop them all like this, but they should be hot in cache so ¯\_(ツ)_/¯
-    for (auto& event : helpers::const_iterate(events())) {
-        EASY_BLOCK("Handling event", profiler::colors::Amber100);
-        switch (event.type) {
-            case "engine/exit"_event:
-                return false;
-            case "engine/set-system-status/running"_event:
-                m_system_status = SystemStatus::Running;
-                break;
-            case "engine/set-system-status/stopped"_event:
-                m_system_status = SystemStatus::Stopped;
-                break;
-            case "scene/registry/runtime->background"_event:
-                copyRegistry(m_registry, m_background_registry);
-                break;
-            case "scene/registry/background->runtime"_event:
-                {
-                    auto names = m_named_entities;
-                    copyRegistry(m_background_registry, m_registry);
-                    m_named_entities = names;
-                }
-                break;
-            case "scene/registry/clear-background"_event:
-                m_background_registry.clear();
-                break;
-            case "scene/registry/clear-runtime"_event:
-                m_registry.clear();
-                break;
-            default:
-                break;
-        };
+    if (m_recorder || m_replay) {
+        captureInputEvents(carried_input_events);
+    }
+
+    // Work out how many ticks this frame runs: always one in variable-tick mode
+    std::uint32_t ticks = 1;
+    Time frame_time = current_time;
+    if (m_tick_delta > 0) {
+        // Fixed-tick mode: run as many whole ticks as the frame time covers, carrying the remainder over to the next frame
+        m_tick_accumulator += delta;
+        ticks = std::uint32_t(m_tick_accumulator / m_tick_delta);
+        if (ticks > m_max_ticks_per_frame) {
+            // The simulation can't keep up: drop the time it is behind by, rather than running ever more ticks per frame
+            SPDLOG_DEBUG("Frame {} needed {} ticks, only running {}", frame_count, ticks, m_max_ticks_per_frame);
+            ticks = m_max_ticks_per_frame;
+            m_tick_accumulator = 0;
+        } else {
+            m_tick_accumulator -= DeltaTime(ticks) * m_tick_delta;
+        }
+        // Frame level logic sees the simulations time, so that timers scheduled from it use the same clock as the ticks
+        frame_time = m_simulation_time;
+    }
+    m_current_time = frame_time;
+    m_current_time_delta = delta;
+
+    // Act on the engine events pumped since the previous frame
+    if (! applyEngineRequests()) {
+        return false;
     }
 
     // Run the before-frame hook for each module, updating the current time
-    callModuleHook<CM::BEFORE_FRAME>(current_time, delta, frame_count);
+    callModuleHook<CM::BEFORE_FRAME>(frame_time, delta, m_current_frame);
 
-    if (m_system_status == SystemStatus::Running) {
-        // Execute the taskflow graph if systems are running
-        EASY_BLOCK("Executing tasks", profiler::colors::Indigo200);
-        m_executor.run(m_coordinator);
+    if (m_dirty_stages != 0) {
+        // Systems were added or a module was reloaded since the last frame, no run is in progress so the graph can be swapped safely
+        createTaskGraph();
+    }
+
+    if (m_tick_delta > 0) {
+        for (std::uint32_t tick = 0; tick < ticks; ++tick) {
+            // Keep the state of the previous tick, so that the renderer can interpolate between the last two ticks
+            storePreviousState();
+            m_simulation_time += m_tick_delta;
+            simulate(m_simulation_time, m_tick_delta);
+        }
+        m_interpolation_alpha = float(m_tick_accumulator / m_tick_delta);
+        frame_time = m_simulation_time;
     } else {
-        // If systems are stopped, only pump events
-        pumpEvents();
+        // Variable-tick mode: simulate once per frame, by however long the previous frame took
+        simulate(current_time, delta);
     }
+    m_current_time = frame_time;
+    m_current_time_delta = delta;
 
     // Run the after-frame hook for each module
-    callModuleHook<CM::AFTER_FRAME>();
+    callModuleHook<CM::AFTER_FRAME>(frame_time, delta, m_current_frame);
+
+    // A frame may run any number of ticks, so the events they pumped are only complete once they have all run
+    if (m_recorder) {
+        m_recorder->record(frame_count, current_time, delta, m_captured_input_events, m_captured_pumped_events);
+    } else if (m_replay) {
+        m_replay->verify(m_captured_pumped_events);
+    }
 
     /*
-     * Hand over exclusive access to engine state to renderer.
-     * Renderer will access the ECS registry to gather all components needed for rendering, accumulate
-     * a render list and hand exclusive access back to the engine. The renderer wil then asynchronously
-     * render from its locally owned render list.
+     * Publish this frames render data to the render thread, without waiting for it: the renderer always renders the newest
+     * published frame, so simulation and rendering overlap. When headless, there is no renderer to publish to.
      */
-    {
-        EASY_BLOCK("Waiting on renderer", profiler::colors::Red100);
-        // First, signal to the renderer that it has exclusive access to the engines state
-        {
-            std::scoped_lock<std::mutex> lock(m_graphics_sync->state_mutex);
-            m_graphics_sync->owner = graphics::Sync::Owner::Renderer;
+    if (! m_headless) {
+        graphics::publish(m_renderer, m_executor, m_current_frame);
+
+        /*
+         * Modules with onPrepareRender hooks need exclusive access to engine state while their hooks run on the render thread,
+         * so hand it over to the renderer and wait for it to be handed back.
+         */
+        if (! m_hooks_prepareRender.empty()) {
+            EASY_BLOCK("Waiting on renderer", profiler::colors::Red100);
+            // First, signal to the renderer that it has exclusive access to the engines state
+            {
+                std::scoped_lock<std::mutex> lock(m_graphics_sync->state_mutex);
+                m_graphics_sync->owner = graphics::Sync::Owner::Renderer;
+            }
+            m_graphics_sync->sync_cv.notify_one();
+
+            // Now wait for the renderer to relinquish exclusive access back to the engine
+            std::unique_lock<std::mutex> lock(m_graphics_sync->state_mutex);
+            m_graphics_sync->sync_cv.wait(lock, [this]{ return m_graphics_sync->owner == graphics::Sync::Owner::Engine; });
         }
-        m_graphics_sync->sync_cv.notify_one();
+    }
+
+    // Still running, return true.
+    return true;
+}
 
-        // Now wait for the renderer to relinquish exclusive access back to the engine
-        std::unique_lock<std::mutex> lock(m_graphics_sync->state_mutex);
-        m_graphics_sync->sync_cv.wait(lock, [this]{ return m_graphics_sync->owner == graphics::Sync::Owner::Engine; });
+void core::Engine::simulate (Time current_time, DeltaTime delta)
+{
+    EASY_FUNCTION(profiler::colors::Blue200);
+    m_current_time = current_time;
+    m_current_time_delta = delta;
+    ++m_current_step;
+    if (m_recorder || m_replay) {
+        capturePumpedEvents();
     }
 
-    /*
-     * Engine has exclusive access again.
-     */
+    if (m_system_status == SystemStatus::Running) {
+        // Execute the taskflow graph if systems are running
+        EASY_BLOCK("Executing tasks", profiler::colors::Indigo200);
+        m_systems_start = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_timing_epoch).count();
+        m_executor.run(m_coordinator).wait();
+        collectSystemTimings();
+    } else {
+        // If systems are stopped, only pump events
+        pumpEvents();
+    }
+}
 
-    // Still running, return true.
+void core::Engine::gatherEngineRequests ()
+{
+    // Each event type is read from its own channel, so they are handled in this fixed order rather than the order they were emitted in,
+    // except for system status requests, where the last one emitted wins as it always has.
+    auto& requests = m_engine_requests;
+    requests.exit |= events("engine/exit"_event).count > 0;
+    const bool run_requested = events("engine/set-system-status/running"_event).count > 0;
+    const bool stop_requested = events("engine/set-system-status/stopped"_event).count > 0;
+    if (run_requested && stop_requested) {
+        // Conflicting requests: the channels don't keep the order between types, so find whichever was emitted last
+        for (const auto& event : events()) {
+            if (event.type == "engine/set-system-status/running"_event) {
+                requests.status = SystemStatus::Running;
+            } else if (event.type == "engine/set-system-status/stopped"_event) {
+                requests.status = SystemStatus::Stopped;
+            }
+        }
+        requests.set_status = true;
+    } else if (run_requested) {
+        requests.status = SystemStatus::Running;
+        requests.set_status = true;
+    } else if (stop_requested) {
+        requests.status = SystemStatus::Stopped;
+        requests.set_status = true;
+    }
+    requests.runtime_to_background |= events("scene/registry/runtime->background"_event).count > 0;
+    requests.background_to_runtime |= events("scene/registry/background->runtime"_event).count > 0;
+    requests.clear_background |= events("scene/registry/clear-background"_event).count > 0;
+    requests.clear_runtime |= events("scene/registry/clear-runtime"_event).count > 0;
+}
+
+bool core::Engine::applyEngineRequests ()
+{
+    // Input can also request an exit, its events are readable without being pumped
+    if (m_engine_requests.exit || events("engine/exit"_event).count > 0) {
+        return false;
+    }
+    const auto requests = m_engine_requests;
+    m_engine_requests = {};
+    if (requests.set_status) {
+        m_system_status = requests.status;
+    }
+    if (requests.runtime_to_background) {
+        copyRegistry(m_registry, m_background_registry);
+    }
+    if (requests.background_to_runtime) {
+        copyRegistry(m_background_registry, m_registry);
+    }
+    if (requests.clear_background) {
+        m_background_registry.clear();
+    }
+    if (requests.clear_runtime) {
+        m_registry.clear();
+    }
     return true;
 }
 
+
+void core::Engine::storePreviousState ()
+{
+    EASY_FUNCTION(profiler::colors::Blue300);
+    // Entries are only valid for the tick they were stored in, so entities that lost their Position (or were destroyed) drop out by themselves
+    const std::uint32_t tick = ++m_previous_tick;
+    m_previous_state.resize(std::max(m_previous_state.size(), m_registry.size()));
+    m_registry.view<const components::Position>().each([this, tick](const auto entity, const auto& position){
+        auto& previous = m_previous_state[std::size_t(entt::to_integral(entt::registry::entity(entity)))];
+        previous.entity = entity;
+        previous.tick = tick;
+        previous.has_transform = false;
+        previous.point = position.point;
+    });
+    m_registry.view<const components::Position, const components::Transform>().each([this](const auto entity, const auto&, const auto& transform){
+        auto& previous = m_previous_state[std::size_t(entt::to_integral(entt::registry::entity(entity)))];
+        previous.has_transform = true;
+        previous.rotation = transform.rotation;
+        previous.scale = transform.scale;
+    });
+}
+
 void core::Engine::reset ()
 {
     // Unload the current scene
     callModuleHook<CM::UNLOAD_SCENE>();
     // Shut down graphics thread
-    graphics::term(m_renderer);
+    if (m_headless) {
+        delete m_renderer;
+    } else {
+        graphics::term(m_renderer);
+    }
+    // Finish recording
+    if (m_recorder) {
+        m_recorder->close();
+    }
     // Delete event pools
     for (auto pool : m_event_pools) {
         delete pool;
     }
+    m_event_pools.clear();
+    for (auto pool : m_external_event_pools) {
+        delete pool;
+    }
+    m_external_event_pools.clear();
+    for (std::uint32_t index = 0; index < m_payload_arena_count.load(); ++index) {
+        delete m_payload_arenas[index];
+        m_payload_arenas[index] = nullptr;
+        m_payload_arena_external[index] = false;
+    }
+    m_payload_arena_count = 0;
+    for (auto staging : m_timer_stagings) {
+        delete staging;
+    }
+    m_timer_stagings.clear();
+    // Every threads pointers to the objects deleted above are now stale, they'll create new ones the next time they emit
+    m_emitter_generation = nextEmitterGeneration();
+    for (auto blocks : m_read_blocks) {
+        m_event_blocks.release(blocks);
+    }
+    m_read_blocks.clear();
     // Clear the registry
     m_registry = {};
     // Clear background registry
     m_background_registry = {};
     // Clear the prototype registry
     m_prototype_registry = {};
+    m_prototype_recipes.clear();
+    m_previous_state.clear();
+    m_engine_requests = {};
 }
 
-void core::Engine::copyRegistry (const entt::registry& from, entt::registry& to)
+void core::Engine::captureInputEvents (std::uint32_t carried)
 {
-    EASY_FUNCTION(profiler::colors::RichYellow);
-    to = {}; // TODO: Relax the requirement to copy to an empty registry
-    to.assign(from.data(), from.data() + from.size(), from.destroyed());
-    from.visit([&from, &to](const auto info) {
-        from.storage(info)->copy_to(to);
+    m_captured_input_events.clear();
+    m_captured_pumped_events.clear();
+    m_input_event_pool.each_block([this, &carried](const gou::events::Event* events, std::uint32_t count) {
+        const std::uint32_t skip = std::min(carried, count);
+        carried -= skip;
+        m_captured_input_events.insert(m_captured_input_events.end(), events + skip, events + count);
     });
 }
 
+void core::Engine::capturePumpedEvents ()
+{
+    for (const auto* blocks : m_read_blocks) {
+        ThreadEventPool::each_block(blocks, [this](const gou::events::Event* events, std::uint32_t count) {
+            m_captured_pumped_events.insert(m_captured_pumped_events.end(), events, events + count);
+        });
+    }
+}
+
 void core::Engine::onAddNamedEntity (entt::registry& registry, entt::entity entity)
 {
     const auto& named = registry.get<components::Named>(entity);
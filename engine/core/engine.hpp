@@ -3,9 +3,18 @@
 #include "gou_engine.hpp"
 #include <gou/api.hpp>
 #include "world/scenes.hpp"
+#include "core/timer_wheel.hpp"
+#include "core/recorder.hpp"
+#include "memory/ring_buffer.hpp"
+#include "utils/clock.hpp"
 
 #include <SDL.h>
 
+#include <array>
+#include <atomic>
+#include <deque>
+#include <thread>
+
 #include <taskflow/taskflow.hpp>
 
 namespace graphics {
@@ -24,6 +33,32 @@ namespace core {
         entt::hashed_string::hash_type id;
     };
 
+    /**
+     * A prototype entity compiled into a flat list of its components, so that instantiating it doesn't have to discover its
+     * components again. Trivially copyable components are copied into one contiguous blob, others are read from the prototype.
+     */
+    struct PrototypeRecipe {
+        struct Component {
+            entt::type_info storage;
+            std::uint32_t offset;
+            std::uint32_t size;
+            bool from_blob;
+        };
+        entt::entity prototype;
+        std::vector<Component> components;
+        std::vector<char> blob;
+    };
+
+    // The state of an entity at the start of the current simulation tick, so that the renderer can interpolate in fixed-tick mode
+    struct PreviousState {
+        entt::entity entity = entt::null;
+        std::uint32_t tick = 0;
+        bool has_transform = false;
+        glm::vec3 point;
+        glm::vec3 rotation;
+        glm::vec3 scale;
+    };
+
     /**
      * Engine is the API through which functionality is registered with the engine.
      * This is responsible for accessing the ECS registry, registering up ECS system tasks, registering components and providing "core" services.
@@ -34,20 +69,55 @@ namespace core {
         Engine();
         virtual ~Engine();
 
-        using EventPool = memory::StackPool<gou::events::Event, memory::AlignCacheLine>;
+        static constexpr std::uint32_t EventBlockCapacity = 64;
+        using ThreadEventPool = memory::ChunkedStackPool<gou::events::Event, EventBlockCapacity>;
+        using PayloadArena = memory::FrameArena<65536, 16>;
+        // Payload handles store the arena index + 1 in 8 bits
+        static constexpr std::uint32_t MaxPayloadArenas = 0xff;
+
+        // Scheduled events are staged per thread and applied to one of two timer wheels
+        enum class TimerWheelType : std::uint32_t {
+            Time,   // Ticks are milliseconds of engine time
+            Frames, // Ticks are simulation ticks (one per frame in variable-tick mode)
+        };
+        struct PendingTimer {
+            TimerWheelType wheel;
+            TimerWheel::Handle handle;
+            std::uint64_t expiry;
+            std::uint32_t interval;
+            gou::events::Event event;
+        };
+        struct TimerStaging {
+            std::vector<TimerWheel::Handle> reserved[2]; // Handles reserved from each wheel, so scheduling doesn't need to lock
+            std::vector<PendingTimer> scheduled;
+            std::vector<gou::events::TimerHandle> cancelled;
+            bool external; // Staged by a thread outside the engines frame (the render thread), see m_render_emit_mutex
+        };
 
         // Implement API interface
         gou::api::detail::type_context* type_context() const final;
         gou::api::Renderer& renderer () const final;
         void readBinaryFile (const std::string& filename, std::string& buffer) const final;
         gou::events::Event* emit () final;
+        std::uint32_t emitPayload (const void*, std::size_t) final;
+        const void* payload (std::uint32_t) final;
+        gou::events::TimerHandle emitAt (Time, const gou::events::Event&) final;
+        gou::events::TimerHandle emitAfter (DeltaTime, const gou::events::Event&) final;
+        gou::events::TimerHandle emitEvery (std::uint32_t, const gou::events::Event&) final;
+        void cancelTimer (gou::events::TimerHandle) final;
         const gou::api::detail::EventsIterator& events () final;
+        gou::api::detail::EventChannelIterator events (entt::hashed_string::hash_type) final;
+        const std::vector<gou::api::SystemStats>& systemStats () final;
+        void parallelFor (std::size_t, std::size_t, ParallelForFn, const void*) final;
         entt::registry& registry (gou::api::Registry) final;
         entt::organizer& organizer (gou::api::SystemStage) final;
         entt::entity findEntity (entt::hashed_string) const final;
         const std::string& findEntityName (const components::Named&) const final;
         entt::entity loadEntity (entt::hashed_string) final;
         void mergeEntity (entt::entity, entt::hashed_string, bool) final;
+        bool loadEntities (entt::hashed_string, std::size_t, entt::entity*, LoadEntitiesFn, const void*) final;
+        bool saveSnapshot (const entt::registry&, const std::string&) final;
+        bool loadSnapshot (entt::registry&, const std::string&) final;
         void registerComponent (gou::api::definitions::Component&) final;
         const std::vector<gou::api::definitions::Component>& getRegisteredComponents () final;
         gou::resources::Handle findResource (entt::hashed_string::hash_type) final;
@@ -56,12 +126,27 @@ namespace core {
         // Time
         DeltaTime deltaTime () { return m_current_time_delta; }
 
+        // How far between the previous and the current simulation tick the rendered frame is, always 1 in variable-tick mode
+        float interpolationAlpha () const { return m_interpolation_alpha; }
+
+        // The state of an entity at the start of the current tick, nullptr if it had no Position then. Only read, so safe to call from any thread during render data extraction
+        const PreviousState* previousState (entt::entity entity) const {
+            const auto index = std::size_t(entt::to_integral(entt::registry::entity(entity)));
+            if (index < m_previous_state.size() && m_previous_state[index].entity == entity && m_previous_state[index].tick == m_previous_tick) {
+                return &m_previous_state[index];
+            }
+            return nullptr;
+        }
+
         // Initialise engine, before modules are loaded
         ImGuiContext* init ();
 
         // Initialise systems and load game data, after modules are loaded
         void setupGame ();
 
+        // The executor running the engines tasks, so that the render thread can spread work across the same workers
+        tf::Executor& executor () { return m_executor; }
+
         // Provide access to input events
         const std::vector<SDL_Event>& inputEvents () {
             return m_input_events;
@@ -79,23 +164,31 @@ namespace core {
             if constexpr (Hook == CM::BEFORE_FRAME) {
                 EASY_BLOCK("callModuleHook<BEFORE_FRAME>", profiler::colors::Indigo100);
                 for (auto& mod : m_hooks_beforeFrame) {
+                    m_active_module = mod;
                     mod->on_before_frame(args...);
                 }
+                m_active_module = nullptr;
             } else if constexpr (Hook == CM::AFTER_FRAME) {
                 EASY_BLOCK("callModuleHook<AFTER_FRAME>", profiler::colors::Indigo100);
                 for (auto& mod : m_hooks_afterFrame) {
+                    m_active_module = mod;
                     mod->on_after_frame(args...);
                 }
+                m_active_module = nullptr;
             } else if constexpr (Hook == CM::LOAD_SCENE) {
                 EASY_BLOCK("callModuleHook<LOAD_SCENE>", profiler::colors::Indigo100);
                 for (auto& mod : m_hooks_loadScene) {
+                    m_active_module = mod;
                     mod->on_load_scene(args...);
                 }
+                m_active_module = nullptr;
             } else if constexpr (Hook == CM::UNLOAD_SCENE) {
                 EASY_BLOCK("callModuleHook<UNLOAD_SCENE>", profiler::colors::Indigo100);
                 for (auto& mod : m_hooks_unloadScene) {
+                    m_active_module = mod;
                     mod->on_unload_scene(args...);
                 }
+                m_active_module = nullptr;
             } else if constexpr (Hook == CM::PREPARE_RENDER) {
                 EASY_BLOCK("callModuleHook<PREPARE_RENDER>", profiler::colors::Indigo100);
                 for (auto& mod : m_hooks_prepareRender) {
@@ -103,11 +196,13 @@ namespace core {
                 }
             } else if constexpr (Hook == CM::BEFORE_RENDER) {
                 EASY_BLOCK("callModuleHook<BEFORE_RENDER>", profiler::colors::Indigo100);
+                std::scoped_lock<std::mutex> lock(m_render_emit_mutex);
                 for (auto& mod : m_hooks_beforeRender) {
                     mod->on_before_render(args...);
                 }
             } else if constexpr (Hook == CM::AFTER_RENDER) {
                 EASY_BLOCK("callModuleHook<AFTER_RENDER>", profiler::colors::Indigo100);
+                std::scoped_lock<std::mutex> lock(m_render_emit_mutex);
                 for (auto& mod : m_hooks_afterRender) {
                     mod->on_after_render(args...);
                 }
@@ -122,6 +217,14 @@ namespace core {
         // Register module hooks
         void registerModule (std::uint32_t, gou::api::Module*);
 
+        // Set the module that systems are being registered for, nullptr when no module is active
+        void setActiveModule (gou::api::Module* mod) { m_active_module = mod; }
+
+        // Called around a modules (potential) hot reload. If the module reloaded, its old systems are discarded and replaced by
+        // any it registered while reloading and its hooks are pointed at its new instance. Takes effect on the next frame
+        void beginModuleUpdate (gou::api::Module*);
+        void endModuleUpdate (gou::api::Module* old_module, gou::api::Module* new_module, bool reloaded);
+
         template <typename... Args>
         gou::events::Event& emit (Args&&... args) {
             return gou::api::helpers::emitEvent(*this, std::forward<Args>(args)...);
@@ -149,22 +252,84 @@ namespace core {
         std::vector<gou::api::definitions::Component> m_component_definitions;
         spp::sparse_hash_map<entt::hashed_string::hash_type, NamedEntityInfo, helpers::Identity> m_named_entities;
         spp::sparse_hash_map<entt::hashed_string::hash_type, entt::entity, helpers::Identity> m_prototype_entities;
+        // Compiled on first use, dropped whenever the prototype changes
+        spp::sparse_hash_map<entt::hashed_string::hash_type, PrototypeRecipe, helpers::Identity> m_prototype_recipes;
+        // Connected to the signals of every registered component of the prototype registry, to drop the recipes of changed prototypes
+        PolyStorageWatcher<entt::entity> m_prototype_watcher{&core::Engine::onPrototypeComponentChanged, this};
         world::SceneManager m_scene_manager;
         const std::string m_empty_string = {};
 
         // System and task scheduling
-        spp::sparse_hash_map<gou::api::SystemStage, entt::organizer> m_organizers;
+        using StageOrganizers = spp::sparse_hash_map<gou::api::SystemStage, entt::organizer>;
+        struct ModuleSystems {
+            gou::api::Module* module;
+            StageOrganizers organizers;
+        };
+        std::deque<ModuleSystems> m_module_systems; // In registration order. Systems registered outside of a module hook are kept under nullptr
+        gou::api::Module* m_active_module = nullptr; // The module whose hook is running, which any systems registered now belong to
+        StageOrganizers m_stashed_organizers; // A modules organizers, set aside while it is being updated
+        std::uint32_t m_dirty_stages = ~0u; // Bit per SystemStage whose systems changed since the task graph was last built
+        std::unique_ptr<tf::Taskflow> m_stage_taskflows[2];
         tf::Taskflow m_coordinator;
         tf::Executor m_executor;
 
+        // System timing
+        struct SystemTimingSample {
+            std::uint32_t system;
+            std::int32_t worker;
+            std::int64_t start; // Nanoseconds since m_timing_epoch
+            std::int64_t end;
+        };
+        using SystemTimingRing = memory::SPSCRingBuffer<SystemTimingSample, 1024>;
+        struct SystemTiming {
+            std::string name;
+            gou::api::SystemStage stage;
+            float samples[gou::api::SystemStats::Window]; // Durations in milliseconds, a rolling window of the most recent runs
+            std::uint32_t next;
+            std::uint32_t count;
+            std::int32_t worker;
+            float start;
+            float last;
+        };
+        Clock::time_point m_timing_epoch;
+        std::int64_t m_systems_start = 0;
+        std::vector<std::unique_ptr<SystemTimingRing>> m_system_timing_rings; // One per worker, each written only by its own worker
+        std::vector<SystemTiming> m_system_timings;
+        std::vector<gou::api::SystemStats> m_system_stats;
+        bool m_system_stats_dirty = false;
+
         enum class SystemStatus {
             Running,
             Stopped,
         };
         SystemStatus m_system_status;
+        // Requests made to the engine through events, gathered by each pump and applied once at the start of the next frame
+        struct EngineRequests {
+            bool exit = false;
+            bool set_status = false;
+            SystemStatus status = SystemStatus::Running;
+            bool runtime_to_background = false;
+            bool background_to_runtime = false;
+            bool clear_background = false;
+            bool clear_runtime = false;
+        };
+        EngineRequests m_engine_requests;
 
         // Timing
+        Time m_current_time = 0;
         DeltaTime m_current_time_delta = 0;
+        std::uint64_t m_current_frame = 0;
+        std::uint64_t m_current_step = 0; // Ticks simulated so far, drives the frames timer wheel
+
+        // Fixed-tick simulation, disabled when the tick delta is 0
+        DeltaTime m_tick_delta;
+        std::uint32_t m_max_ticks_per_frame;
+        DeltaTime m_tick_accumulator = 0;
+        Time m_simulation_time = 0;
+        float m_interpolation_alpha = 1.0f;
+        // Indexed by entity identifier. Kept out of the registry, so that it is never copied with it or seen by systems
+        std::vector<PreviousState> m_previous_state;
+        std::uint32_t m_previous_tick = 0;
 
         // Module Hooks
         std::vector<gou::api::Module*> m_hooks_beforeFrame;
@@ -177,6 +342,7 @@ namespace core {
         std::vector<gou::api::Module*> m_hooks_afterRender;
 
         // Render state
+        bool m_headless = false;
         gou::api::Renderer* m_renderer;
         graphics::Sync* m_graphics_sync;
 
@@ -188,9 +354,46 @@ namespace core {
         std::vector<SDL_Event> m_input_events;
 
         // Events
+        struct EventChannel {
+            std::uint32_t offset;
+            std::uint32_t count;
+        };
         gou::api::detail::EventsIterator m_events_iterator;
-        std::vector<EventPool*> m_event_pools;
-        EventPool m_event_pool;
+        ThreadEventPool::FreeList m_event_blocks; // Shared by all thread local event pools
+        std::uint32_t m_event_blocks_reported = 0;
+        std::mutex m_event_pools_mutex;
+        std::vector<ThreadEventPool*> m_event_pools;
+        /*
+         * Threads outside the engines frame (the render threads onBeforeRender and onAfterRender hooks) emit while the engine
+         * is pumping events, so their pools, arenas and timer stagings are kept separately and only handed over when the render
+         * thread isn't inside those hooks, which hold this mutex. The engine only ever tries to lock it, so it never waits on the renderer.
+         */
+        std::mutex m_render_emit_mutex;
+        std::vector<ThreadEventPool*> m_external_event_pools;
+        std::thread::id m_engine_thread;
+        std::uint32_t m_emitter_generation; // Threads emitters from other generations were deleted by reset (or belong to another engine)
+        // Thread local event payloads, index+1 is stored in the payload handles. The array never reallocates, so payloads can be
+        // read without locking while another thread adds its arena, which it publishes by incrementing the count
+        std::array<PayloadArena*, MaxPayloadArenas> m_payload_arenas = {};
+        std::array<bool, MaxPayloadArenas> m_payload_arena_external = {};
+        std::atomic<std::uint32_t> m_payload_arena_count{0};
+        std::vector<ThreadEventPool::Block*> m_read_blocks; // Block chains handed over by the thread local pools, readable this frame
+        ThreadEventPool m_input_event_pool; // Events emitted directly by the engine (eg input), readable this frame
+        std::vector<gou::api::detail::EventsIterator::Segment> m_event_segments;
+        memory::GrowableStackPool<const gou::events::Event*> m_sorted_events; // Pointers to readable events, bucketed by type
+        spp::sparse_hash_map<entt::hashed_string::hash_type, EventChannel, helpers::Identity> m_event_channels;
+
+        // Scheduled events
+        std::mutex m_timers_mutex;
+        TimerWheel m_timer_wheels[2];
+        std::vector<TimerStaging*> m_timer_stagings; // Thread local timer requests, applied to the wheels when events are pumped
+        ThreadEventPool m_timer_event_pool; // Events emitted by expired timers, handed over with the thread local pools
+
+        // Event recording and replay
+        std::unique_ptr<EventRecorder> m_recorder;
+        std::unique_ptr<EventReplay> m_replay;
+        std::vector<gou::events::Event> m_captured_input_events;
+        std::vector<gou::events::Event> m_captured_pumped_events; // Accumulated over every tick of the frame
 
         // Implement API interface
         void* allocModule (std::size_t bytes) final;
@@ -199,9 +402,36 @@ namespace core {
         // Add a module to be called by a specific engine hook
         void addModuleHook (gou::api::Module::CallbackMasks hook, gou::api::Module* module);
 
-        // Create task execution graph
+        // Create the task execution graph, rebuilding the taskflows of any stages whose systems changed
         void createTaskGraph ();
 
+        // Create a taskflow for the systems of all modules in a stage
+        tf::Taskflow* createStageTaskflow (gou::api::SystemStage);
+
+        // Find (or add) the timing slot of a system
+        std::uint32_t findSystemTiming (const char* name, gou::api::SystemStage);
+
+        // Run a system, making its subflow available to parallelFor for the duration of the call
+        void runSystem (tf::Subflow& subflow, entt::organizer::function_type* callback, const void* userdata, entt::registry& registry);
+
+        // Record a systems run into the calling workers timing ring
+        void recordSystemTiming (std::uint32_t system, Clock::time_point start, Clock::time_point end);
+
+        // Drain the timing rings into each systems rolling window
+        void collectSystemTimings ();
+
+        // Run one simulation tick: the task graph, or only the event pump while systems are stopped
+        void simulate (Time current_time, DeltaTime delta);
+
+        // Collect the requests made to the engine by the events that were just pumped, called by every pump
+        void gatherEngineRequests ();
+
+        // Act on the requests collected since the previous frame. Returns false if the engine should exit
+        bool applyEngineRequests ();
+
+        // Copy the Position and Transform components of every entity into m_previous_state
+        void storePreviousState ();
+
         // Load game data and initialise games first scene
         void setupInitialScene();
 
@@ -211,18 +441,46 @@ namespace core {
         // Make emitted events available to read and make a fresh event queue available to emit to
         void pumpEvents ();
 
-        // Emit an event directly to the global pool (warning: unsynchronised)
+        // Emit an event directly to the readable events (warning: unsynchronised)
         template <typename... Args> void internalEmplaceEvent (Args&&... args) {
-            m_event_pool.emplace(std::forward<Args>(args)...);
+            m_input_event_pool.emplace(std::forward<Args>(args)...);
         }
 
-        // Update the global event pool iterator to see all events in the global pool
+        // Stage a timer on the calling thread, it is added to the wheel when events are next pumped
+        gou::events::TimerHandle scheduleTimer (TimerWheelType, std::uint64_t expiry, std::uint32_t interval, const gou::events::Event&);
+
+        // Apply staged timer requests and emit the events of every timer that has expired. External stagings are only applied if 'external' is set
+        void expireTimers (bool external);
+
+        // A generation number that no engine has used yet, to tell the thread local emitters of this engine apart from deleted ones
+        static std::uint32_t nextEmitterGeneration ();
+
+        // True if the calling thread is neither the engine thread nor one of its workers, so may emit while events are being pumped
+        bool isExternalThread () { return std::this_thread::get_id() != m_engine_thread && m_executor.this_worker_id() < 0; }
+
+        // Copy this frames input events (skipping those carried over from earlier frames) and start a new frame of pumped events, for recording or replay verification
+        void captureInputEvents (std::uint32_t carried);
+
+        // Append the events pumped by the previous tick, called at the start of every tick so that each pump is captured exactly once
+        void capturePumpedEvents ();
+
+        // Update the events iterator to see all readable events and rebuild the per-type event channels
         void refreshEventsIterator ();
 
         // Merge a prototype entity into an entity
         void mergeEntityInternal (entt::entity, entt::entity, bool);
 
-        // Copy all entities from one registry to another
+        // Get the recipe of a prototype, compiling it if it isn't compiled yet. nullptr if there is no such prototype
+        const PrototypeRecipe* prototypeRecipe (entt::hashed_string::hash_type);
+
+        // Add the components of a prototype to entities [first, last), which must not have any of them yet
+        void instantiateRecipe (const PrototypeRecipe&, const entt::entity* first, const entt::entity* last);
+
+        // Drop the recipe of a prototype entity whose components changed
+        void invalidatePrototype (entt::entity);
+        static void onPrototypeComponentChanged (void* engine, entt::registry&, entt::entity);
+
+        // Make one registry a copy of another, changing only the entities and components that differ
         void copyRegistry (const entt::registry& from, entt::registry& to);
 
         // Callbacks to manage Named entities
@@ -2,6 +2,7 @@
 #include "engine.hpp"
 #include "physics/physics.hpp"
 #include "graphics/graphics.hpp"
+#include "graphics/render_api.hpp"
 
 namespace gou {
     void register_components (gou::api::Engine*);
@@ -35,6 +36,12 @@ void core::Engine::registerComponent (gou::api::definitions::Component& componen
 {
     m_component_loaders[component_def.id] = component_def.loader;
     m_component_definitions.push_back(component_def);
+    // Any change to a prototype's components, including direct ones through the prototype registry, invalidates its recipe
+    m_prototype_registry.visit([this, &component_def](const auto info) {
+        if (info.seq() == component_def.type_id) {
+            m_prototype_registry.storage(info)->watch(m_prototype_registry, m_prototype_watcher);
+        }
+    });
 }
 
 void core::Engine::addModuleHook (gou::api::Module::CallbackMasks hook, gou::api::Module* mod) {
@@ -66,44 +73,139 @@ void core::Engine::addModuleHook (gou::api::Module::CallbackMasks hook, gou::api
     };
 }
 
-void core::Engine::createTaskGraph () {
-    // Setup Systems by creating a Taskflow graph for each stage
-    using Stage = gou::api::SystemStage;
+std::uint32_t core::Engine::findSystemTiming (const char* name, gou::api::SystemStage stage)
+{
+    // Systems keep their timing slot across rebuilds, so that their statistics survive a hot reload
+    const std::string system_name = name ? name : "unnamed system";
+    for (std::uint32_t index = 0; index < m_system_timings.size(); ++index) {
+        if (m_system_timings[index].stage == stage && m_system_timings[index].name == system_name) {
+            return index;
+        }
+    }
+    m_system_timings.push_back({system_name, stage});
+    return std::uint32_t(m_system_timings.size() - 1);
+}
+
+tf::Taskflow* core::Engine::createStageTaskflow (gou::api::SystemStage stage) {
+    /*
+     * Each module registers its systems with its own organizers, so that a module can be reloaded without touching the
+     * systems of other modules. EnTT only resolves dependencies between the systems of a single organizer, so those are
+     * kept as they are and dependencies between the systems of different modules are added here, using the same rules:
+     * a system that writes a component runs after every earlier system that reads or writes it, a system that reads a
+     * component runs after its last earlier writer. Systems that don't declare any components (eg ones that only take the
+     * registry) synchronise with every other system. All edges point from earlier to later systems, so the graph is acyclic.
+     */
+    struct ComponentAccess {
+        std::vector<tf::Task> readers; // Readers since the last writer
+        tf::Task writer;
+        bool has_writer = false;
+    };
+    spp::sparse_hash_map<entt::id_type, ComponentAccess, helpers::Identity> access;
+    std::vector<tf::Task> since_barrier;
+    tf::Task barrier;
+    bool has_barrier = false;
+    const entt::id_type registry_type = entt::type_hash<entt::registry>::value();
+    std::vector<const entt::type_info*> types;
+
+    auto taskflow = new tf::Taskflow();
     auto registry = &m_registry;
-    spp::sparse_hash_map<Stage, tf::Taskflow*> taskflows;
-    for (auto type : {Stage::GameLogic, Stage::Update}) {
-        auto it = m_organizers.find(type);
-        if (it != m_organizers.end()) {
-            tf::Taskflow* taskflow = new tf::Taskflow();
-            taskflows[type] = taskflow;
-            std::vector<std::pair<entt::organizer::vertex, tf::Task>> tasks;
-            auto graph = it->second.graph();
-            // First pass, prepare registry and create taskflow task
-            for(auto&& node : graph) {
-                spdlog::debug("Setting up system: {}", node.name());
-                node.prepare(m_registry);
-                auto callback = node.callback();
-                auto userdata = node.data();
-                auto name = node.name();
-                tasks.push_back({
-                    node,
-                    taskflow->emplace([callback, userdata, registry, name](){
-                        spdlog::trace("Running System: {}", name);
-                        callback(userdata, *registry);
-                    }).name(node.name())
-                });
+    for (auto& systems : m_module_systems) {
+        auto it = systems.organizers.find(stage);
+        if (it == systems.organizers.end()) {
+            continue;
+        }
+        auto graph = it->second.graph();
+        std::vector<tf::Task> tasks;
+        for (auto&& node : graph) {
+            spdlog::debug("Setting up system: {}", node.name());
+            node.prepare(m_registry);
+            auto callback = node.callback();
+            auto userdata = node.data();
+            auto name = node.name();
+            const auto system = findSystemTiming(name, stage);
+            // Systems run as subflows, so that data-parallel systems can spread their work across the workers (see parallelFor)
+            tf::Task task = taskflow->emplace([this, callback, userdata, registry, name, system](tf::Subflow& subflow){
+                spdlog::trace("Running System: {}", name);
+                const auto start = Clock::now();
+                runSystem(subflow, callback, userdata, *registry);
+                recordSystemTiming(system, start, Clock::now());
+            }).name(name ? name : "");
+            tasks.push_back(task);
+
+            // Gather the components this system reads and writes
+            const std::size_t ro_count = node.ro_count();
+            types.resize(ro_count + node.rw_count());
+            node.ro_dependency(types.data(), ro_count);
+            node.rw_dependency(types.data() + ro_count, types.size() - ro_count);
+            const bool is_barrier = types.empty() || std::any_of(types.begin(), types.end(), [registry_type](auto type){ return type->hash() == registry_type; });
+
+            if (is_barrier) {
+                // Runs after everything since the previous barrier and everything after it runs after this
+                for (auto& other : since_barrier) {
+                    task.succeed(other);
+                }
+                if (has_barrier && since_barrier.empty()) {
+                    task.succeed(barrier);
+                }
+                access.clear();
+                since_barrier.clear();
+                barrier = task;
+                has_barrier = true;
+                continue;
+            }
+            if (has_barrier) {
+                task.succeed(barrier);
             }
-            // Second pass, set parent-child relationship of tasks
-            for (auto&& [node, task] : tasks) {
-                for (auto index : node.children()) {
-                    task.precede(tasks[index].second);
+            for (std::size_t index = 0; index < types.size(); ++index) {
+                auto& component = access[types[index]->hash()];
+                if (index >= ro_count) {
+                    // Writer
+                    for (auto& reader : component.readers) {
+                        task.succeed(reader);
+                    }
+                    if (component.has_writer && component.readers.empty()) {
+                        task.succeed(component.writer);
+                    }
+                    component.readers.clear();
+                    component.writer = task;
+                    component.has_writer = true;
+                } else {
+                    // Reader
+                    if (component.has_writer) {
+                        task.succeed(component.writer);
+                    }
+                    component.readers.push_back(task);
                 }
             }
-            it->second.clear();
+            since_barrier.push_back(task);
+        }
+        // Keep the dependencies EnTT resolved between this modules systems
+        for (std::size_t index = 0; index < graph.size(); ++index) {
+            for (auto child : graph[index].children()) {
+                tasks[index].precede(tasks[child]);
+            }
         }
     }
-    // Any new additions will never be added to the Taskflow graph, so no point in keeping the organizers around
-    m_organizers.clear();
+    return taskflow;
+}
+
+void core::Engine::createTaskGraph () {
+    EASY_FUNCTION(profiler::colors::Indigo300);
+    // The coordinating graph is only a handful of tasks, so it is always rebuilt from scratch
+    m_coordinator.clear();
+
+    // Only the stages whose systems changed are rebuilt, the taskflows of unchanged stages are reused as they are
+    using Stage = gou::api::SystemStage;
+    for (auto stage : {Stage::GameLogic, Stage::Update}) {
+        const auto index = helpers::enum_value(stage);
+        if (m_dirty_stages & (1u << index)) {
+            m_stage_taskflows[index].reset(createStageTaskflow(stage));
+        }
+    }
+    m_dirty_stages = 0;
+
+    tf::Taskflow* game_logic_flow = m_stage_taskflows[helpers::enum_value(Stage::GameLogic)].get();
+    tf::Taskflow* updater_flow = m_stage_taskflows[helpers::enum_value(Stage::Update)].get();
 
     /** Task graph:
      * 
@@ -126,7 +228,7 @@ void core::Engine::createTaskGraph () {
         physics::simulate(m_physics_context);
     }).name("Physics/simulate");
     tf::Task before_update_task = m_coordinator.emplace([this](){
-        callModuleHook<CM::BEFORE_UPDATE>();
+        callModuleHook<CM::BEFORE_UPDATE>(m_current_time, m_current_time_delta, m_current_frame);
     }).name("Hooks/before-update");
     tf::Task pump_events_task = m_coordinator.emplace([this](){
         pumpEvents(); // Copy current frames events for processing next frame
@@ -135,7 +237,7 @@ void core::Engine::createTaskGraph () {
     physics_task_simulate.succeed(physics_task_prepare);
     
     // Add engine-internal tasks to graph and coordinate flow into one graph
-    if (tf::Taskflow* game_logic_flow = helpers::find_or(taskflows, Stage::GameLogic, nullptr)) {
+    if (game_logic_flow && ! game_logic_flow->empty()) {
         game_logic_flow->name("Game Logic");
         tf::Task game_logic_tasks = m_coordinator.composed_of(*game_logic_flow).name("Systems");
 #ifdef BUILD_WITH_EASY_PROFILER
@@ -152,7 +254,7 @@ void core::Engine::createTaskGraph () {
         game_logic_tasks.precede(before_update_task, physics_task_prepare);
 #endif
     }
-    if (tf::Taskflow* updater_flow = helpers::find_or(taskflows, Stage::Update, nullptr)) {
+    if (updater_flow && ! updater_flow->empty()) {
         updater_flow->name("State Update");
         tf::Task updater_tasks = m_coordinator.composed_of(*updater_flow).name("Systems");
 #ifdef BUILD_WITH_EASY_PROFILER
@@ -182,15 +284,37 @@ void core::Engine::createTaskGraph () {
 ImGuiContext* core::Engine::init ()
 {
     // Setup renderer
-    ImGuiContext* imgui_ctx;
-    m_renderer = graphics::init(*this, m_graphics_sync, imgui_ctx);
+    ImGuiContext* imgui_ctx = nullptr;
+    m_headless = entt::monostate<"graphics/headless"_hs>();
+    if (m_headless) {
+        spdlog::info("Running headless");
+        m_renderer = new graphics::HeadlessRenderer;
+        m_graphics_sync = nullptr;
+    } else {
+        m_renderer = graphics::init(*this, m_graphics_sync, imgui_ctx);
+    }
     // Register core components
     gou::register_components(this);
     // Set system status
     m_system_status = SystemStatus::Running;
 
+    // Set up event recording or replay, if requested
+    const std::string& record_file = entt::monostate<"tools/record-file"_hs>();
+    const std::string& replay_file = entt::monostate<"tools/replay-file"_hs>();
+    if (! replay_file.empty()) {
+        m_replay = std::make_unique<EventReplay>();
+        if (! m_replay->open(replay_file, entt::monostate<"tools/replay-timings-file"_hs>())) {
+            throw std::runtime_error("Could not start replay");
+        }
+    } else if (! record_file.empty()) {
+        m_recorder = std::make_unique<EventRecorder>();
+        if (! m_recorder->open(record_file)) {
+            throw std::runtime_error("Could not start recording");
+        }
+    }
+
     // Sync with graphics to make sure render thread is set up before continuing
-    {
+    if (! m_headless) {
         // First, signal to the renderer that it has exclusive access to the engines state
         {
             std::scoped_lock<std::mutex> lock(m_graphics_sync->state_mutex);
@@ -12,6 +12,8 @@
 
 #include <physfs.hpp>
 
+#include <thread>
+
 void setupPhysFS (const char* argv0)
 {
     const std::vector<std::string>& sourcePaths = entt::monostate<"game/sources"_hs>{};
@@ -86,14 +88,16 @@ int main (int argc, char* argv[])
     
     // Now start up the engine
     spdlog::info("Initialising");
-    if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER) < 0)
+    // Headless, there is no window or input devices, but SDL still delivers quit events (eg on SIGINT)
+    const bool headless = entt::monostate<"graphics/headless"_hs>();
+    if (SDL_Init(headless ? SDL_INIT_EVENTS : (SDL_INIT_VIDEO | SDL_INIT_GAMECONTROLLER)) < 0)
     {
         spdlog::critical("Failed to initialise SDL");
         return 0;
     }
 
     // Load game controller mapping
-    {
+    if (! headless) {
         std::string controllerMapping = helpers::readToString("gamecontrollerdb.txt");
         auto rwop = SDL_RWFromConstMem(controllerMapping.data(), controllerMapping.size());
         defer_calls([&rwop]{SDL_RWclose(rwop);});
@@ -120,6 +124,11 @@ int main (int argc, char* argv[])
             auto previous_time = start_time;
             auto current_time = start_time;
             uint64_t total_frames = 0;
+            // Without a renderer (and v-sync) to pace it, a headless engine in fixed-tick mode waits out the rest of each tick.
+            // In variable-tick mode, or when replaying a recording, it runs as fast as it can
+            const DeltaTime tick_delta = entt::monostate<"simulation/tick-delta"_hs>();
+            const std::string& replay_file = entt::monostate<"tools/replay-file"_hs>();
+            const auto headless_frame_time = std::chrono::microseconds(headless && replay_file.empty() ? ElapsedTime(tick_delta * 1000000.0) : ElapsedTime{0});
     #ifdef DEV_MODE
             ElapsedTime last_update_time = 0L; // microseconds
             const ElapsedTime update_interval = entt::monostate<"dev-mode/reload-interval"_hs>();
@@ -133,6 +142,10 @@ int main (int argc, char* argv[])
                     break;
                 }
 
+                if (headless_frame_time.count() > 0) {
+                    std::this_thread::sleep_until(current_time + headless_frame_time);
+                }
+
                 // Update timekeeping
                 previous_time = current_time;
                 current_time = Clock::now();
@@ -151,6 +164,7 @@ int main (int argc, char* argv[])
                 // In dev mode, update plugins every few seconds for hot code reloading
                 if (time_since_start - last_update_time > update_interval) {
                     moduleManager.update();
+                    last_update_time = time_since_start;
                 }
     #endif
             } while (true);
@@ -2,45 +2,317 @@
 #include <gou_engine.hpp>
 #include "engine.hpp"
 
-using EventPool = core::Engine::EventPool;
+using ThreadEventPool = core::Engine::ThreadEventPool;
 
-thread_local EventPool* g_event_pool = nullptr;
+using PayloadArena = core::Engine::PayloadArena;
+
+// A threads pool, payload arena and timer staging. They are owned (and deleted on reset) by the engine that created them
+struct ThreadEmitters {
+    std::uint32_t generation = 0;
+    ThreadEventPool* event_pool = nullptr;
+    PayloadArena* payload_arena = nullptr;
+    std::uint32_t payload_arena_id = 0;
+    core::Engine::TimerStaging* timer_staging = nullptr;
+};
+thread_local ThreadEmitters g_emitters;
+
+// Every engine instance and every reset gets a new generation, so thread locals left over from before are never used
+std::atomic<std::uint32_t> g_emitter_generations{0};
+
+std::uint32_t core::Engine::nextEmitterGeneration ()
+{
+    return ++g_emitter_generations;
+}
+
+// The calling threads emitters, cleared if they belong to an earlier generation (their objects have been deleted)
+ThreadEmitters& thread_emitters (std::uint32_t generation)
+{
+    if (g_emitters.generation != generation) {
+        g_emitters = {};
+        g_emitters.generation = generation;
+    }
+    return g_emitters;
+}
+
+// Number of timer handles a thread reserves from a wheel at a time
+constexpr std::uint32_t TimerReserveBatch = 64;
+// The top bit of a timer handle id selects the wheel, the rest is the index into the wheel
+constexpr std::uint32_t TimerWheelBit = 0x80000000;
+
+/*
+ * Payload handles pack the arena, block and offset of a payload into 32 bits:
+ *      [ arena index + 1 : 8 ][ block : 12 ][ offset (in units of 16 bytes) : 12 ]
+ * A 64KB block holds exactly 4096 units of 16 bytes. Handle 0 means no payload.
+ */
+namespace payload_handle {
+    constexpr std::uint32_t ArenaShift = 24;
+    constexpr std::uint32_t BlockShift = 12;
+    constexpr std::uint32_t MaxArenas = core::Engine::MaxPayloadArenas;
+    constexpr std::uint32_t Mask = 0xfff;
+}
 
 gou::events::Event* core::Engine::emit ()
 {
-    if (g_event_pool == nullptr) {
+    auto& emitters = thread_emitters(m_emitter_generation);
+    if (emitters.event_pool == nullptr) {
         // Lazy initialisation is unfortunately the only way we can initialise thread_local variables after config is read
-        const std::uint32_t event_pool_size = entt::monostate<"memory/events/pool-size"_hs>();
-        g_event_pool = new EventPool(event_pool_size);
-        m_event_pools.push_back(g_event_pool); // Keep track of this pool so that we can gather the events into a global pool at the end of each frame
+        emitters.event_pool = new ThreadEventPool(m_event_blocks);
+        // Keep track of this pool so that its events can be handed over to the readable events at the end of each frame
+        std::scoped_lock<std::mutex> lock(m_event_pools_mutex);
+        if (isExternalThread()) {
+            m_external_event_pools.push_back(emitters.event_pool);
+        } else {
+            m_event_pools.push_back(emitters.event_pool);
+        }
+    }
+    // Thread local pools grow by taking blocks from the shared freelist, so emitting never fails mid-frame
+    return emitters.event_pool->allocate();
+}
+
+std::uint32_t core::Engine::emitPayload (const void* data, std::size_t size)
+{
+    auto& emitters = thread_emitters(m_emitter_generation);
+    if (emitters.payload_arena == nullptr) {
+        std::scoped_lock<std::mutex> lock(m_event_pools_mutex);
+        const std::uint32_t count = m_payload_arena_count.load(std::memory_order_relaxed);
+        if (count >= payload_handle::MaxArenas) {
+            spdlog::error("Too many threads emitting event payloads, payload dropped");
+            return 0;
+        }
+        emitters.payload_arena = new PayloadArena;
+        m_payload_arenas[count] = emitters.payload_arena;
+        m_payload_arena_external[count] = isExternalThread();
+        // Readers that see the new count also see the arena
+        m_payload_arena_count.store(count + 1, std::memory_order_release);
+        emitters.payload_arena_id = count + 1;
+    }
+    PayloadArena::Location location;
+    std::byte* memory = emitters.payload_arena->allocate(size, location);
+    if (location.block > payload_handle::Mask) {
+        spdlog::error("Too many event payloads emitted in one frame, payload dropped");
+        return 0;
+    }
+    std::memcpy(memory, data, size);
+    return (emitters.payload_arena_id << payload_handle::ArenaShift) | (location.block << payload_handle::BlockShift) | location.offset;
+}
+
+const void* core::Engine::payload (std::uint32_t handle)
+{
+    const std::uint32_t arena_id = handle >> payload_handle::ArenaShift;
+    if (arena_id == 0 || arena_id > m_payload_arena_count.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return m_payload_arenas[arena_id - 1]->get({
+        (handle >> payload_handle::BlockShift) & payload_handle::Mask,
+        handle & payload_handle::Mask,
+    });
+}
+
+gou::events::TimerHandle core::Engine::emitAt (Time time, const gou::events::Event& event)
+{
+    return scheduleTimer(TimerWheelType::Time, std::uint64_t(std::max(time, 0.0f) * 1000.0), 0, event);
+}
+
+gou::events::TimerHandle core::Engine::emitAfter (DeltaTime seconds, const gou::events::Event& event)
+{
+    return emitAt(m_current_time + seconds, event);
+}
+
+gou::events::TimerHandle core::Engine::emitEvery (std::uint32_t frames, const gou::events::Event& event)
+{
+    frames = std::max(frames, std::uint32_t{1});
+    return scheduleTimer(TimerWheelType::Frames, m_current_step + frames, frames, event);
+}
+
+void core::Engine::cancelTimer (gou::events::TimerHandle timer)
+{
+    if (timer.generation == 0) {
+        return;
+    }
+    auto& emitters = thread_emitters(m_emitter_generation);
+    if (emitters.timer_staging == nullptr) {
+        emitters.timer_staging = new TimerStaging{{}, {}, {}, isExternalThread()};
+        std::scoped_lock<std::mutex> lock(m_timers_mutex);
+        m_timer_stagings.push_back(emitters.timer_staging);
+    }
+    emitters.timer_staging->cancelled.push_back(timer);
+}
+
+gou::events::TimerHandle core::Engine::scheduleTimer (TimerWheelType type, std::uint64_t expiry, std::uint32_t interval, const gou::events::Event& event)
+{
+    auto& emitters = thread_emitters(m_emitter_generation);
+    if (emitters.timer_staging == nullptr) {
+        // Like the event pools, timer requests are staged per thread, so that systems can schedule timers without synchronisation
+        emitters.timer_staging = new TimerStaging{{}, {}, {}, isExternalThread()};
+        std::scoped_lock<std::mutex> lock(m_timers_mutex);
+        m_timer_stagings.push_back(emitters.timer_staging);
     }
-    return g_event_pool->allocate();
+    const auto wheel = helpers::enum_value(type);
+    auto& reserved = emitters.timer_staging->reserved[wheel];
+    if (reserved.empty()) {
+        // Handles must be unique across threads, so reserve a batch of them at once to keep locking rare
+        std::scoped_lock<std::mutex> lock(m_timers_mutex);
+        for (std::uint32_t i = 0; i < TimerReserveBatch; ++i) {
+            reserved.push_back(m_timer_wheels[wheel].allocate());
+        }
+    }
+    const TimerWheel::Handle handle = reserved.back();
+    reserved.pop_back();
+    emitters.timer_staging->scheduled.push_back({type, handle, expiry, interval, event});
+    emitters.timer_staging->scheduled.back().event.handle = 0; // Payloads only live for a frame, so can't be scheduled
+    return {handle.index | (wheel ? TimerWheelBit : 0), handle.generation};
+}
+
+void core::Engine::expireTimers (bool external)
+{
+    EASY_FUNCTION(profiler::colors::Amber100);
+    std::scoped_lock<std::mutex> lock(m_timers_mutex);
+    // Apply all staged timers before any cancellations, so that timers can be cancelled on the frame they were scheduled
+    for (auto* staging : m_timer_stagings) {
+        if (staging->external && ! external) {
+            continue;
+        }
+        for (const auto& pending : staging->scheduled) {
+            m_timer_wheels[helpers::enum_value(pending.wheel)].schedule(pending.handle, pending.expiry, pending.interval, pending.event);
+        }
+        staging->scheduled.clear();
+    }
+    for (auto* staging : m_timer_stagings) {
+        if (staging->external && ! external) {
+            continue;
+        }
+        for (const auto& timer : staging->cancelled) {
+            const std::uint32_t wheel = (timer.id & TimerWheelBit) ? 1 : 0;
+            m_timer_wheels[wheel].cancel({timer.id & ~TimerWheelBit, timer.generation});
+        }
+        staging->cancelled.clear();
+    }
+    // Expired events go into the engines own chunked pool, so expiring timers never allocates once the freelist is warm
+    auto fire = [this](const gou::events::Event& event) {
+        m_timer_event_pool.emplace(event);
+    };
+    m_timer_wheels[helpers::enum_value(TimerWheelType::Time)].advance(std::uint64_t(m_current_time * 1000.0), fire);
+    m_timer_wheels[helpers::enum_value(TimerWheelType::Frames)].advance(m_current_step, fire);
 }
 
-// Move events from the thread local pools into the global event pool
+// Hand the thread local pools events over to the readable events, without copying them
 void core::Engine::pumpEvents ()
 {
     EASY_FUNCTION(profiler::colors::Amber200);
-    m_event_pool.reset();
-    // Copy thread local events into global pool and reset thread local pools
-    for (auto* pool : m_event_pools) {
-        m_event_pool.copy<EventPool>(*pool);
-        pool->reset();
+    // Last frames events are no longer readable, recycle their blocks
+    for (auto* blocks : m_read_blocks) {
+        m_event_blocks.release(blocks);
+    }
+    m_read_blocks.clear();
+    m_input_event_pool.reset();
+    /*
+     * Every thread in the engines frame has finished emitting by now, but the render thread may be inside a hook that emits.
+     * If it is, its events, payloads and timers are left with it until the next frame, rather than waiting for it.
+     */
+    std::unique_lock<std::mutex> render_emit_lock(m_render_emit_mutex, std::try_to_lock);
+    const bool external = render_emit_lock.owns_lock();
+    // Emit the events of timers that expired this frame, so they become readable with the rest of this frames events
+    expireTimers(external);
+    {
+        // The render thread may be adding its pool right now
+        std::scoped_lock<std::mutex> lock(m_event_pools_mutex);
+        // Take the thread local pools blocks by pointer, each pool continues with a fresh block
+        for (auto* pool : m_event_pools) {
+            if (pool->count() > 0) {
+                m_read_blocks.push_back(pool->handover());
+            }
+        }
+        if (external) {
+            for (auto* pool : m_external_event_pools) {
+                if (pool->count() > 0) {
+                    m_read_blocks.push_back(pool->handover());
+                }
+            }
+        }
+    }
+    if (m_timer_event_pool.count() > 0) {
+        m_read_blocks.push_back(m_timer_event_pool.handover());
+    }
+    // Payloads become readable along with their events, last frames payloads are recycled in bulk
+    const std::uint32_t arenas = m_payload_arena_count.load(std::memory_order_acquire);
+    for (std::uint32_t index = 0; index < arenas; ++index) {
+        if (external || ! m_payload_arena_external[index]) {
+            m_payload_arenas[index]->swap();
+        }
+    }
+    if (external) {
+        // Let the render thread back into its hooks
+        render_emit_lock.unlock();
+    }
+    // Report when the freelist had to grow, so that memory/events/pool-size ([memory.events] per-thread-pool-size) can be tuned for the common case
+    const std::uint32_t allocated_blocks = m_event_blocks.count();
+    if (allocated_blocks > m_event_blocks_reported) {
+        spdlog::debug("Event blocks grew to {} (high-water mark: {} blocks of {} events), consider raising [memory.events] per-thread-pool-size", allocated_blocks, m_event_blocks.highWaterMark(), EventBlockCapacity);
+        m_event_blocks_reported = allocated_blocks;
     }
     refreshEventsIterator();
+    gatherEngineRequests();
 }
 
-// Make the global event pool visible to consumers
+// Make the readable events visible to consumers
 void core::Engine::refreshEventsIterator ()
 {
-    // Create iterator for consumers
+    EASY_FUNCTION(profiler::colors::Amber300);
+    // Gather the blocks of readable events into a segment list for the consumers iterator
+    std::size_t total_events = 0;
+    auto add_segment = [this, &total_events](const gou::events::Event* events, std::uint32_t count) {
+        m_event_segments.push_back({events, count});
+        total_events += count;
+    };
+    m_event_segments.clear();
+    for (const auto* blocks : m_read_blocks) {
+        ThreadEventPool::each_block(blocks, add_segment);
+    }
+    m_input_event_pool.each_block(add_segment);
     m_events_iterator = {
-        const_cast<gou::api::detail::EventsIterator::Type*>(m_event_pool.begin()),
-        m_event_pool.count(),
+        m_event_segments.data(),
+        m_event_segments.size(),
+        total_events,
     };
+
+    /*
+     * Bucket pointers to the events by type into contiguous per-type channels (counting sort), so that consumers
+     * only interested in specific event types don't need to scan every event. Channels are never erased, so once
+     * an event type has been seen, no further allocation happens for it. Order within a channel is preserved.
+     */
+    for (auto& [type, channel] : m_event_channels) {
+        channel.count = 0;
+    }
+    // Count events of each type
+    for (const auto& event : m_events_iterator) {
+        ++m_event_channels[event.type].count;
+    }
+    // Assign each channel its offset in the sorted pointers
+    std::uint32_t offset = 0;
+    for (auto& [type, channel] : m_event_channels) {
+        channel.offset = offset;
+        offset += channel.count;
+        channel.count = 0; // Reused as the write cursor below
+    }
+    // Scatter pointers to the events into their channels
+    m_sorted_events.reset();
+    const gou::events::Event** sorted_events = m_sorted_events.allocate(std::uint32_t(total_events));
+    for (const auto& event : m_events_iterator) {
+        auto& channel = m_event_channels[event.type];
+        sorted_events[channel.offset + channel.count++] = &event;
+    }
 }
 
 const gou::api::detail::EventsIterator& core::Engine::events ()
 {
     return m_events_iterator;
 }
+
+gou::api::detail::EventChannelIterator core::Engine::events (entt::hashed_string::hash_type type)
+{
+    auto it = m_event_channels.find(type);
+    if (it != m_event_channels.end()) {
+        return {m_sorted_events.begin() + it->second.offset, it->second.count};
+    }
+    return {nullptr, 0};
+}
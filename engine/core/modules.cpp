@@ -101,7 +101,9 @@ bool core::ModuleManager::load (std::shared_ptr<spdlog::logger> logger, ImGuiCon
     if (success) {
         for (auto& ctx : m_data->modules) {
             auto info = static_cast<gou::api::detail::ModuleInfo*>(ctx.userdata);
+            m_engine->setActiveModule(info->mod);
             m_engine->registerModule(info->mod->on_load(), info->mod);
+            m_engine->setActiveModule(nullptr);
         }
     } else {
         unload();
@@ -113,7 +115,13 @@ bool core::ModuleManager::load (std::shared_ptr<spdlog::logger> logger, ImGuiCon
 void core::ModuleManager::update ()
 {
     for (auto& ctx : m_data->modules) {
+        // Let the engine know when a module reloads, so that its systems get rebuilt from its new code
+        auto info = static_cast<gou::api::detail::ModuleInfo*>(ctx.userdata);
+        auto old_module = info->mod;
+        const auto version = ctx.version;
+        m_engine->beginModuleUpdate(old_module);
         cr_plugin_update(ctx);
+        m_engine->endModuleUpdate(old_module, info->mod, ctx.version != version);
     }
 }
 
@@ -0,0 +1,38 @@
+
+#include "engine.hpp"
+
+// The subflow of the system running on this worker, if it hasn't been used by parallelFor yet
+thread_local tf::Subflow* g_system_subflow = nullptr;
+
+void core::Engine::runSystem (tf::Subflow& subflow, entt::organizer::function_type* callback, const void* userdata, entt::registry& registry)
+{
+    // While a system waits on its chunks, the worker may run other systems, so restore whatever was there before
+    tf::Subflow* previous = g_system_subflow;
+    g_system_subflow = &subflow;
+    callback(userdata, registry);
+    g_system_subflow = previous;
+}
+
+void core::Engine::parallelFor (std::size_t count, std::size_t chunk_size, ParallelForFn fn, const void* userdata)
+{
+    if (count == 0) {
+        return;
+    }
+    chunk_size = std::max(chunk_size, std::size_t{1});
+    const std::size_t chunks = (count + chunk_size - 1) / chunk_size;
+    tf::Subflow* subflow = g_system_subflow;
+    if (chunks == 1 || subflow == nullptr) {
+        // Not worth splitting, or not called from a system (or the systems subflow was already joined): run on the calling thread
+        fn(userdata, 0, count);
+        return;
+    }
+    EASY_FUNCTION(profiler::colors::Blue300);
+    // A subflow can only be joined once
+    g_system_subflow = nullptr;
+    subflow->for_each_index(std::size_t{0}, chunks, std::size_t{1}, [=](std::size_t chunk){
+        const std::size_t begin = chunk * chunk_size;
+        fn(userdata, begin, std::min(begin + chunk_size, count));
+    });
+    // The calling worker helps run the chunks while it waits for them
+    subflow->join();
+}
@@ -4,15 +4,67 @@
 entt::entity core::Engine::loadEntity (entt::hashed_string prototype_id)
 {
     EASY_FUNCTION(profiler::colors::Yellow100);
-    auto it = m_prototype_entities.find(prototype_id);
-    if (it != m_prototype_entities.end()) {
+    if (const auto* recipe = prototypeRecipe(prototype_id)) {
         auto entity = m_registry.create();
-        mergeEntityInternal(entity, it->second, true);
+        instantiateRecipe(*recipe, &entity, &entity + 1);
         return entity;
     }
     return entt::null;
 }
 
+bool core::Engine::loadEntities (entt::hashed_string prototype_id, std::size_t count, entt::entity* entities, LoadEntitiesFn init, const void* userdata)
+{
+    EASY_FUNCTION(profiler::colors::Yellow100);
+    const auto* recipe = prototypeRecipe(prototype_id);
+    if (! recipe) {
+        return false;
+    }
+    m_registry.create(entities, entities + count);
+    instantiateRecipe(*recipe, entities, entities + count);
+    if (init) {
+        for (std::size_t index = 0; index < count; ++index) {
+            init(userdata, entities[index], index);
+        }
+    }
+    return true;
+}
+
+const core::PrototypeRecipe* core::Engine::prototypeRecipe (entt::hashed_string::hash_type prototype_id)
+{
+    auto recipe = m_prototype_recipes.find(prototype_id);
+    if (recipe != m_prototype_recipes.end()) {
+        return &recipe->second;
+    }
+    auto it = m_prototype_entities.find(prototype_id);
+    if (it == m_prototype_entities.end()) {
+        return nullptr;
+    }
+    EASY_BLOCK("Compile prototype recipe", profiler::colors::Yellow200);
+    PrototypeRecipe& compiled = m_prototype_recipes[prototype_id];
+    compiled.prototype = it->second;
+    m_prototype_registry.visit(compiled.prototype, [this,&compiled](const auto info) {
+        auto&& prototype_storage = m_prototype_registry.storage(info);
+        const char* instance = static_cast<const char*>(prototype_storage->get(compiled.prototype));
+        const std::uint32_t size = std::uint32_t(prototype_storage->packed_size());
+        // Each component is read in place from the blob, so keep it aligned as if it had been allocated on its own
+        const auto alignment = alignof(std::max_align_t);
+        const std::uint32_t offset = std::uint32_t((compiled.blob.size() + alignment - 1) & ~(alignment - 1));
+        compiled.blob.resize(offset);
+        compiled.blob.insert(compiled.blob.end(), instance, instance + size);
+        // Empty components have no instance and nothing to copy
+        compiled.components.push_back({info, offset, size, size > 0 || instance == nullptr});
+    });
+    return &compiled;
+}
+
+void core::Engine::instantiateRecipe (const PrototypeRecipe& recipe, const entt::entity* first, const entt::entity* last)
+{
+    for (const auto& component : recipe.components) {
+        const void* instance = component.from_blob ? recipe.blob.data() + component.offset : m_prototype_registry.storage(component.storage)->get(recipe.prototype);
+        m_registry.storage(component.storage)->fill(m_registry, first, last, instance);
+    }
+}
+
 void core::Engine::mergeEntity (entt::entity entity, entt::hashed_string prototype_id, bool overwrite_components)
 {
     EASY_FUNCTION(profiler::colors::Yellow100);
@@ -31,6 +83,17 @@ void core::Engine::mergeEntityInternal (entt::entity entity, entt::entity protot
     });
 }
 
+void core::Engine::invalidatePrototype (entt::entity prototype_entity)
+{
+    if (const auto* prototype_id = m_prototype_registry.try_get<core::EntityPrototypeID>(prototype_entity)) {
+        m_prototype_recipes.erase(prototype_id->id);
+    }
+}
+
+void core::Engine::onPrototypeComponentChanged (void* engine, entt::registry&, entt::entity entity)
+{
+    static_cast<core::Engine*>(engine)->invalidatePrototype(entity);
+}
 
 void core::Engine::onAddPrototypeEntity (entt::registry& registry, entt::entity entity)
 {
@@ -41,10 +104,13 @@ void core::Engine::onAddPrototypeEntity (entt::registry& registry, entt::entity
         m_prototype_registry.destroy(it->second);
     }
     m_prototype_entities[prototype_id.id] = entity;
+    // The prototype's components are added after its ID, so its recipe is compiled when it is first instantiated
+    m_prototype_recipes.erase(prototype_id.id);
 }
 
 void core::Engine::onRemovePrototypeEntity (entt::registry& registry, entt::entity entity)
 {
     const auto& prototype_id = registry.get<core::EntityPrototypeID>(entity);
     m_prototype_entities.erase(prototype_id.id);
+    m_prototype_recipes.erase(prototype_id.id);
 }
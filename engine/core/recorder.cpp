@@ -0,0 +1,126 @@
+
+#include "recorder.hpp"
+
+// Order-independent fingerprint of a set of events. Attributes are left out, as floating point results may differ between builds
+std::uint64_t fingerprint (const std::vector<gou::events::Event>& events)
+{
+    std::uint64_t sum = 0;
+    for (const auto& event : events) {
+        std::uint64_t hash = 0xcbf29ce484222325ull;
+        for (std::uint32_t value : {std::uint32_t(event.type), std::uint32_t(event.source), std::uint32_t(event.value)}) {
+            hash = (hash ^ value) * 0x100000001b3ull;
+        }
+        sum += hash;
+    }
+    return sum;
+}
+
+bool core::EventRecorder::open (const std::string& filename)
+{
+    m_file.open(filename, std::ios::binary | std::ios::trunc);
+    if (! m_file) {
+        spdlog::error("Could not open event recording file: {}", filename);
+        return false;
+    }
+    const recording::FileHeader header{recording::Magic, recording::Version, std::uint32_t(sizeof(gou::events::Event)), 0};
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    spdlog::info("Recording events to: {}", filename);
+    return true;
+}
+
+void core::EventRecorder::record (std::uint64_t frame, Time time, DeltaTime delta, const std::vector<gou::events::Event>& input, const std::vector<gou::events::Event>& pumped)
+{
+    EASY_FUNCTION(profiler::colors::Amber400);
+    const recording::FrameHeader header{frame, time, delta, std::uint32_t(input.size()), std::uint32_t(pumped.size())};
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.write(reinterpret_cast<const char*>(input.data()), std::streamsize(input.size() * sizeof(gou::events::Event)));
+    m_file.write(reinterpret_cast<const char*>(pumped.data()), std::streamsize(pumped.size() * sizeof(gou::events::Event)));
+    ++m_frames;
+}
+
+void core::EventRecorder::close ()
+{
+    if (m_file.is_open()) {
+        m_file.close();
+        spdlog::info("Recorded {} frames of events", m_frames);
+    }
+}
+
+bool core::EventReplay::open (const std::string& filename, const std::string& timings_filename)
+{
+    m_file.open(filename, std::ios::binary);
+    if (! m_file) {
+        spdlog::error("Could not open event recording file: {}", filename);
+        return false;
+    }
+    recording::FileHeader header;
+    m_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (! m_file || header.magic != recording::Magic || header.version != recording::Version) {
+        spdlog::error("Not a valid event recording: {}", filename);
+        return false;
+    }
+    if (header.event_size != sizeof(gou::events::Event)) {
+        spdlog::error("Event recording {} was made with a different event layout ({} bytes, expected {})", filename, header.event_size, sizeof(gou::events::Event));
+        return false;
+    }
+    if (! timings_filename.empty()) {
+        m_timings.open(timings_filename, std::ios::trunc);
+        if (! m_timings) {
+            spdlog::error("Could not open replay timings file: {}", timings_filename);
+            return false;
+        }
+        m_timings << "frame,recorded_delta_us,replayed_us\n";
+    }
+    spdlog::info("Replaying events from: {}", filename);
+    return true;
+}
+
+bool core::EventReplay::next ()
+{
+    EASY_FUNCTION(profiler::colors::Amber400);
+    const auto now = Clock::now();
+    if (m_started) {
+        finishFrame(now);
+    }
+    m_started = true;
+    m_frame_start = now;
+
+    m_file.read(reinterpret_cast<char*>(&m_frame), sizeof(m_frame));
+    if (m_file) {
+        m_input.resize(m_frame.input_events);
+        m_pumped.resize(m_frame.pumped_events);
+        m_file.read(reinterpret_cast<char*>(m_input.data()), std::streamsize(m_input.size() * sizeof(gou::events::Event)));
+        m_file.read(reinterpret_cast<char*>(m_pumped.data()), std::streamsize(m_pumped.size() * sizeof(gou::events::Event)));
+    }
+    if (! m_file) {
+        const ElapsedTime average = m_frames > 0 ? m_total_micros / ElapsedTime(m_frames) : 0;
+        spdlog::info("Replay finished: {} frames, {} diverged from the recording, {:.3f}ms average frame time, {:.3f}ms worst frame time",
+            m_frames, m_diverged_frames, average / 1000.0f, m_max_micros / 1000.0f);
+        m_started = false;
+        return false;
+    }
+    return true;
+}
+
+bool core::EventReplay::verify (const std::vector<gou::events::Event>& pumped)
+{
+    if (pumped.size() != m_pumped.size() || fingerprint(pumped) != fingerprint(m_pumped)) {
+        // Only report the first divergence, as every frame after it is likely to diverge too
+        if (m_diverged_frames++ == 0) {
+            spdlog::warn("Replay diverged from the recording on frame {}: {} events were pumped, {} were recorded", m_frame.frame, pumped.size(), m_pumped.size());
+        }
+        return false;
+    }
+    return true;
+}
+
+void core::EventReplay::finishFrame (Clock::time_point now)
+{
+    const ElapsedTime micros = std::chrono::duration_cast<std::chrono::microseconds>(now - m_frame_start).count();
+    m_total_micros += micros;
+    m_max_micros = std::max(m_max_micros, micros);
+    ++m_frames;
+    if (m_timings.is_open()) {
+        m_timings << m_frame.frame << ',' << ElapsedTime(m_frame.delta * 1000000.0) << ',' << micros << '\n';
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <gou_engine.hpp>
+#include "utils/clock.hpp"
+
+#include <fstream>
+
+namespace core {
+
+    /**
+     * Binary event stream recordings.
+     * A recording is a FileHeader followed by one record per frame. Each frame record is a FrameHeader, followed by the
+     * input events that arrived that frame (input carried over from a frame that ran no ticks is only recorded once) and then the
+     * pumped events read by each of the frames ticks (none, in a frame that ran no ticks), stored as raw gou::events::Event structs.
+     * Event payloads are not recorded, so payload handles in a recording are meaningless.
+     */
+    namespace recording {
+        constexpr std::uint32_t Magic = 0x52554f47; // "GOUR"
+        constexpr std::uint32_t Version = 3;
+
+        struct FileHeader {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint32_t event_size;
+            std::uint32_t reserved;
+        };
+
+        struct FrameHeader {
+            std::uint64_t frame;
+            Time time;
+            DeltaTime delta;
+            std::uint32_t input_events;
+            std::uint32_t pumped_events;
+        }; // 24 bytes
+    }
+
+    // Writes the events readable at the start of each frame to a recording
+    class EventRecorder {
+    public:
+        bool open (const std::string& filename);
+        void record (std::uint64_t frame, Time time, DeltaTime delta, const std::vector<gou::events::Event>& input, const std::vector<gou::events::Event>& pumped);
+        void close ();
+
+    private:
+        std::ofstream m_file;
+        std::uint64_t m_frames = 0;
+    };
+
+    /**
+     * Reads a recording back one frame at a time.
+     * Only the input events are fed back into the engine, the pumped events are used to detect divergence: if the game
+     * is deterministic, the systems will emit the same events they emitted during recording.
+     * Optionally writes the wall-clock time of each replayed frame to a CSV file, so that two builds can be compared.
+     */
+    class EventReplay {
+    public:
+        bool open (const std::string& filename, const std::string& timings_filename);
+
+        // Read the next frame, returns false once the recording is exhausted
+        bool next ();
+
+        const recording::FrameHeader& frame () const { return m_frame; }
+        const std::vector<gou::events::Event>& inputEvents () const { return m_input; }
+
+        // Compare the events pumped this time around with the recording, ignoring order (which depends on thread scheduling)
+        bool verify (const std::vector<gou::events::Event>& pumped);
+
+    private:
+        std::ifstream m_file;
+        std::ofstream m_timings;
+        recording::FrameHeader m_frame;
+        std::vector<gou::events::Event> m_input;
+        std::vector<gou::events::Event> m_pumped;
+        Clock::time_point m_frame_start;
+        bool m_started = false;
+        // Totals, reported once the recording is exhausted
+        std::uint64_t m_frames = 0;
+        std::uint64_t m_diverged_frames = 0;
+        ElapsedTime m_total_micros = 0;
+        ElapsedTime m_max_micros = 0;
+
+        void finishFrame (Clock::time_point now);
+    };
+
+} // core::
@@ -0,0 +1,113 @@
+
+#include "engine.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+
+// Components per task when comparing the components of a storage
+constexpr std::size_t SyncChunkSize = 16384;
+
+void core::Engine::copyRegistry (const entt::registry& from, entt::registry& to)
+{
+    EASY_FUNCTION(profiler::colors::RichYellow);
+    /*
+     * Rather than rebuilding 'to' from scratch, only what differs is changed: entities are created and destroyed slot by slot and
+     * each storage adds, removes and replaces only the components that differ. Systems write components in place through views,
+     * which entt can't observe, so changes are found by comparing rather than tracked through signals. As 'to' is never replaced,
+     * its signal handlers (such as those that maintain named entities) stay connected and see exactly the changes made.
+     */
+    const entt::entity* from_entities = from.data();
+    std::size_t changed = 0;
+    std::size_t created = 0;
+    for (std::size_t index = 0; index < std::max(from.size(), to.size()); ++index) {
+        const entt::entity entity = index < from.size() ? from_entities[index] : entt::entity{entt::null};
+        if (entity != (index < to.size() ? to.data()[index] : entt::entity{entt::null})) {
+            ++changed;
+            created += index < from.size() && from.valid(entity) ? 1 : 0;
+        }
+    }
+    // Creating an entity with a given identifier searches the free list, so if many need to be recreated, or most of the registry
+    // differs anyway (such as when swapping in a different scene), rebuilding is cheaper
+    const bool rebuild = changed > from.size() / 8 || created > 4096;
+    if (rebuild) {
+        to.clear();
+        to.assign(from.data(), from.data() + from.size(), from.destroyed());
+    } else {
+        for (std::size_t index = 0; index < std::max(from.size(), to.size()); ++index) {
+            const entt::entity entity = index < from.size() ? from_entities[index] : entt::entity{entt::null};
+            const bool alive = index < from.size() && from.valid(entity);
+            if (alive && to.valid(entity)) {
+                continue;
+            }
+            // The destination may have a different version of the entity alive in this slot
+            if (index < to.size()) {
+                const entt::entity existing = to.data()[index];
+                if (to.valid(existing)) {
+                    to.destroy(existing);
+                }
+            }
+            if (alive) {
+                // Creating with a hint keeps the identifier and its version
+                to.create(entity);
+            }
+        }
+    }
+
+    // Entities are in place, so every storage can now be copied independently. The destination storages are all created up front,
+    // as creating one while other tasks are writing to theirs would not be safe
+    std::vector<entt::type_info> storages;
+    from.visit([&from, &to, &storages](const auto info) {
+        from.storage(info)->assure(to);
+        storages.push_back(info);
+    });
+    if (! rebuild) {
+        // Storages the source doesn't have at all
+        to.visit([&to, &storages](const auto info) {
+            auto same = [&info](const auto& other){ return other.hash() == info.hash(); };
+            if (std::find_if(storages.begin(), storages.end(), same) == storages.end()) {
+                to.storage(info)->clear(to);
+            }
+        });
+    }
+
+    // One task per storage (copying, or adding and removing components), followed by the comparison of large storages in chunks
+    std::vector<std::atomic<std::int64_t>> nanos(storages.size());
+    auto timed = [&nanos](std::size_t storage, auto&& fn) {
+        const auto start = Clock::now();
+        fn();
+        nanos[storage] += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+    };
+    tf::Taskflow flow;
+    for (std::size_t storage = 0; storage < storages.size(); ++storage) {
+        const auto info = storages[storage];
+        if (rebuild) {
+            flow.emplace([&from, &to, &timed, info, storage](){
+                timed(storage, [&](){ from.storage(info)->copy_to(to); });
+            });
+            continue;
+        }
+        tf::Task structure = flow.emplace([&from, &to, &timed, info, storage](){
+            timed(storage, [&](){ from.storage(info)->sync_structure_to(to); });
+        });
+        const std::size_t count = from.storage(info)->count();
+        const std::size_t chunks = (count + SyncChunkSize - 1) / SyncChunkSize;
+        tf::Task values = flow.for_each_index(std::size_t{0}, chunks, std::size_t{1}, [&from, &to, &timed, info, storage, count](std::size_t chunk){
+            const std::size_t begin = chunk * SyncChunkSize;
+            timed(storage, [&](){ from.storage(info)->sync_values_to(to, begin, std::min(begin + SyncChunkSize, count)); });
+        });
+        structure.precede(values);
+    }
+    const auto start = Clock::now();
+    m_executor.run(flow).wait();
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+
+    // Report where the time went, most expensive storage first
+    std::vector<std::size_t> order(storages.size());
+    std::iota(order.begin(), order.end(), std::size_t{0});
+    std::sort(order.begin(), order.end(), [&nanos](auto a, auto b){ return nanos[a] > nanos[b]; });
+    spdlog::info("Registry {} in {:.3f}ms: {} entities, {} storages", rebuild ? "rebuilt" : "synced", float(elapsed) / 1000.0f, from.alive(), storages.size());
+    for (auto storage : order) {
+        spdlog::debug("  {}: {:.3f}ms for {} components", storages[storage].name(), float(nanos[storage]) / 1000000.0f, from.storage(storages[storage])->count());
+    }
+}
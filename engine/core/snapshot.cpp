@@ -0,0 +1,210 @@
+
+#include "engine.hpp"
+#include "snapshot.hpp"
+
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// A read-only mapping of a whole file, unmapped when it goes out of scope
+class MappedFile {
+public:
+    MappedFile (const std::string& filename) {
+        const int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return;
+        }
+        struct stat info;
+        if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* address = ::mmap(nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address != MAP_FAILED) {
+                // The whole file is about to be read front to back
+                ::madvise(address, std::size_t(info.st_size), MADV_SEQUENTIAL);
+                ::madvise(address, std::size_t(info.st_size), MADV_WILLNEED);
+                m_data = static_cast<const char*>(address);
+                m_size = std::size_t(info.st_size);
+            }
+        }
+        ::close(fd);
+    }
+    ~MappedFile () {
+        if (m_data) {
+            ::munmap(const_cast<char*>(m_data), m_size);
+        }
+    }
+    MappedFile (const MappedFile&) = delete;
+    MappedFile& operator= (const MappedFile&) = delete;
+
+    const char* data () const { return m_data; }
+    std::size_t size () const { return m_size; }
+
+private:
+    const char* m_data = nullptr;
+    std::size_t m_size = 0;
+};
+
+// Find the storage of every registered component in a registry, by the components id
+spp::sparse_hash_map<entt::id_type, entt::type_info> componentStorages (const entt::registry& registry, const std::vector<gou::api::definitions::Component>& definitions)
+{
+    spp::sparse_hash_map<entt::id_type, entt::type_info> storages;
+    registry.visit([&storages, &definitions](const auto info) {
+        for (const auto& definition : definitions) {
+            if (definition.type_id == info.seq()) {
+                storages[definition.id] = info;
+            }
+        }
+    });
+    return storages;
+}
+
+bool core::Engine::saveSnapshot (const entt::registry& registry, const std::string& filename)
+{
+    EASY_FUNCTION(profiler::colors::RichYellow);
+    const auto start = Clock::now();
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if (! file) {
+        spdlog::error("Could not open snapshot file: {}", filename);
+        return false;
+    }
+    const char padding[snapshot::Alignment] = {};
+    std::size_t offset = 0;
+    auto write = [&file, &offset, &padding](const void* data, std::size_t bytes) {
+        file.write(static_cast<const char*>(data), std::streamsize(bytes));
+        offset += bytes;
+        const std::size_t aligned = snapshot::align(offset);
+        file.write(padding, std::streamsize(aligned - offset));
+        offset = aligned;
+    };
+
+    // The header is written again once the number of storages is known
+    snapshot::FileHeader header{snapshot::Magic, snapshot::Version, std::uint32_t(registry.size()), registry.destroyed(), 0, std::uint32_t(sizeof(entt::entity))};
+    write(&header, sizeof(header));
+    write(registry.data(), registry.size() * sizeof(entt::entity));
+
+    const auto storages = componentStorages(registry, m_component_definitions);
+    std::vector<entt::entity> entities;
+    std::vector<char> values;
+    for (const auto& definition : m_component_definitions) {
+        auto it = storages.find(definition.id);
+        if (it == storages.end() || registry.storage(it->second)->count() == 0) {
+            continue;
+        }
+        entities.clear();
+        values.clear();
+        if (! registry.storage(it->second)->pack(entities, values)) {
+            spdlog::warn("Component {} is left out of snapshot {}, as it isn't trivially copyable", definition.name, filename);
+            continue;
+        }
+        const snapshot::StorageHeader storage{definition.id, std::uint32_t(definition.size_in_bytes), entities.size(), values.size()};
+        write(&storage, sizeof(storage));
+        write(entities.data(), entities.size() * sizeof(entt::entity));
+        write(values.data(), values.size());
+        ++header.storages;
+    }
+    file.seekp(0);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    if (! file) {
+        spdlog::error("Could not write snapshot file: {}", filename);
+        return false;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    spdlog::info("Saved snapshot {} in {:.3f}ms: {} entities, {} storages, {} bytes", filename, float(elapsed) / 1000.0f, registry.alive(), header.storages, offset);
+    return true;
+}
+
+bool core::Engine::loadSnapshot (entt::registry& registry, const std::string& filename)
+{
+    EASY_FUNCTION(profiler::colors::RichYellow);
+    const auto start = Clock::now();
+    MappedFile file(filename);
+    if (! file.data()) {
+        spdlog::error("Could not open snapshot file: {}", filename);
+        return false;
+    }
+    std::size_t offset = 0;
+    // Take 'bytes' bytes from the snapshot, nullptr if it is truncated
+    auto read = [&file, &offset](std::size_t bytes) -> const char* {
+        if (bytes > file.size() - offset) {
+            return nullptr;
+        }
+        const char* data = file.data() + offset;
+        offset = std::min(snapshot::align(offset + bytes), file.size());
+        return data;
+    };
+
+    const auto* header = reinterpret_cast<const snapshot::FileHeader*>(read(sizeof(snapshot::FileHeader)));
+    if (! header || header->magic != snapshot::Magic || header->version != snapshot::Version || header->entity_size != sizeof(entt::entity)) {
+        spdlog::error("Not a valid snapshot: {}", filename);
+        return false;
+    }
+    const auto* entities = reinterpret_cast<const entt::entity*>(read(header->entities * sizeof(entt::entity)));
+    if (! entities) {
+        spdlog::error("Snapshot {} is truncated", filename);
+        return false;
+    }
+
+    // Check every storage before touching the registry, so that a bad snapshot leaves it as it was
+    struct Block {
+        entt::type_info storage;
+        const entt::entity* entities;
+        std::size_t count;
+        const void* values;
+    };
+    std::vector<Block> blocks;
+    const auto storages = componentStorages(registry, m_component_definitions);
+    // For each entity slot, the last storage that had a component on it
+    std::vector<std::uint32_t> seen(header->entities, 0);
+    std::uint32_t stamp = 0;
+    for (std::uint32_t index = 0; index < header->storages; ++index) {
+        const auto* storage = reinterpret_cast<const snapshot::StorageHeader*>(read(sizeof(snapshot::StorageHeader)));
+        const auto* storage_entities = storage && storage->count <= file.size() ? reinterpret_cast<const entt::entity*>(read(storage->count * sizeof(entt::entity))) : nullptr;
+        const char* values = storage_entities ? read(storage->value_bytes) : nullptr;
+        if (! values) {
+            spdlog::error("Snapshot {} is truncated", filename);
+            return false;
+        }
+        auto definition = std::find_if(m_component_definitions.begin(), m_component_definitions.end(), [storage](const auto& definition){ return definition.id == storage->component; });
+        auto it = storages.find(storage->component);
+        if (definition == m_component_definitions.end() || it == storages.end()) {
+            spdlog::error("Snapshot {} contains a component ({}) that isn't registered", filename, storage->component);
+            return false;
+        }
+        auto&& poly = registry.storage(it->second);
+        // Packed size is 0 only for empty components, so every other component must have exactly one value per entity
+        const std::size_t packed_size = poly->packed_size();
+        if (! poly->packable() || definition->size_in_bytes != storage->component_size || (packed_size != 0 && packed_size != storage->component_size)
+                || storage->value_bytes != storage->count * packed_size) {
+            spdlog::error("Snapshot {} was made with a different layout of component {} ({} bytes, expected {})", filename, definition->name, storage->component_size, definition->size_in_bytes);
+            return false;
+        }
+        if (std::any_of(blocks.begin(), blocks.end(), [&it](const auto& block){ return block.storage.hash() == it->second.hash(); })) {
+            spdlog::error("Snapshot {} contains component {} more than once", filename, definition->name);
+            return false;
+        }
+        // Each entity must be alive in the restored registry and have the component at most once, which entt only asserts in debug builds
+        ++stamp;
+        for (std::size_t entity_index = 0; entity_index < storage->count; ++entity_index) {
+            const entt::entity entity = storage_entities[entity_index];
+            const auto slot = std::size_t(entt::to_integral(entt::registry::entity(entity)));
+            if (slot >= header->entities || entities[slot] != entity || seen[slot] == stamp) {
+                spdlog::error("Snapshot {} is corrupt: component {} is attached to an entity that isn't alive, or more than once", filename, definition->name);
+                return false;
+            }
+            seen[slot] = stamp;
+        }
+        blocks.push_back({it->second, storage_entities, std::size_t(storage->count), values});
+    }
+
+    // Restore the entities exactly (identifiers, versions and free list), then insert each storage in bulk, straight from the mapping
+    registry.clear();
+    registry.assign(entities, entities + header->entities, header->destroyed);
+    for (const auto& block : blocks) {
+        registry.storage(block.storage)->unpack(registry, block.entities, block.entities + block.count, block.values);
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    spdlog::info("Loaded snapshot {} in {:.3f}ms: {} entities, {} storages", filename, float(elapsed) / 1000.0f, registry.alive(), blocks.size());
+    return true;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <gou_engine.hpp>
+
+namespace core {
+
+    /**
+     * Binary registry snapshots.
+     * A snapshot is a FileHeader, followed by the registry's entity identifiers and then one block per component storage. Each
+     * block is a StorageHeader, followed by the entities that have the component and then their components, packed in the same
+     * order as raw bytes. Every array starts on a 16 byte boundary, so that a memory-mapped snapshot can be inserted straight
+     * into the registry without copying it first.
+     * Components are identified by the id and size of their gou::api::definitions::Component. Only registered, trivially
+     * copyable components are stored. Components are stored bytewise, so anything that holds pointers or resource handles is
+     * only meaningful within the run that saved the snapshot (checkpoints, quick-saves, restarting a level).
+     */
+    namespace snapshot {
+        constexpr std::uint32_t Magic = 0x53554f47; // "GOUS"
+        constexpr std::uint32_t Version = 1;
+        constexpr std::size_t Alignment = 16;
+
+        struct FileHeader {
+            std::uint32_t magic;
+            std::uint32_t version;
+            std::uint32_t entities;
+            entt::entity destroyed;
+            std::uint32_t storages;
+            std::uint32_t entity_size;
+        }; // 24 bytes
+
+        struct StorageHeader {
+            entt::id_type component;
+            std::uint32_t component_size;
+            std::uint64_t count;
+            std::uint64_t value_bytes;
+        }; // 24 bytes
+
+        constexpr std::size_t align (std::size_t offset) {
+            return (offset + Alignment - 1) & ~(Alignment - 1);
+        }
+    }
+
+} // core::
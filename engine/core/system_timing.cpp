@@ -0,0 +1,80 @@
+
+#include "engine.hpp"
+
+// Milliseconds between two timestamps in nanoseconds
+float to_millis (std::int64_t from, std::int64_t to)
+{
+    return float(to - from) / 1000000.0f;
+}
+
+void core::Engine::recordSystemTiming (std::uint32_t system, Clock::time_point start, Clock::time_point end)
+{
+    // Systems only run on the executors workers, each of which owns a ring, so there is exactly one producer per ring
+    const int worker = m_executor.this_worker_id();
+    if (worker >= 0 && std::size_t(worker) < m_system_timing_rings.size()) {
+        // If the ring is full, the sample is dropped rather than stalling the system
+        m_system_timing_rings[worker]->push({
+            system,
+            worker,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(start - m_timing_epoch).count(),
+            std::chrono::duration_cast<std::chrono::nanoseconds>(end - m_timing_epoch).count(),
+        });
+    }
+}
+
+void core::Engine::collectSystemTimings ()
+{
+    EASY_FUNCTION(profiler::colors::Blue200);
+    for (auto& ring : m_system_timing_rings) {
+        ring->consume([this](const SystemTimingSample& sample) {
+            auto& timing = m_system_timings[sample.system];
+            timing.worker = sample.worker;
+            timing.start = to_millis(m_systems_start, sample.start);
+            timing.last = to_millis(sample.start, sample.end);
+            timing.samples[timing.next] = timing.last;
+            timing.next = (timing.next + 1) % gou::api::SystemStats::Window;
+            timing.count = std::min(timing.count + 1, gou::api::SystemStats::Window);
+        });
+    }
+    m_system_stats_dirty = true;
+}
+
+const std::vector<gou::api::SystemStats>& core::Engine::systemStats ()
+{
+    // Statistics are only calculated when asked for, so that the cost of sorting isn't paid on frames where nobody looks
+    if (m_system_stats_dirty) {
+        EASY_FUNCTION(profiler::colors::Blue200);
+        m_system_stats.resize(m_system_timings.size());
+        float sorted[gou::api::SystemStats::Window];
+        for (std::size_t index = 0; index < m_system_timings.size(); ++index) {
+            const auto& timing = m_system_timings[index];
+            auto& stats = m_system_stats[index];
+            stats.name = timing.name;
+            stats.stage = timing.stage;
+            stats.worker = timing.worker;
+            stats.start = timing.start;
+            stats.last = timing.last;
+            if (timing.count == 0) {
+                stats.mean = stats.p95 = stats.p99 = stats.max = 0;
+                continue;
+            }
+            std::copy(timing.samples, timing.samples + timing.count, sorted);
+            std::sort(sorted, sorted + timing.count);
+            float total = 0;
+            for (std::uint32_t sample = 0; sample < timing.count; ++sample) {
+                total += sorted[sample];
+            }
+            // Nearest-rank percentiles
+            auto percentile = [&sorted, &timing](std::uint32_t percent) {
+                const std::uint32_t rank = (percent * timing.count + 99) / 100;
+                return sorted[std::max(rank, std::uint32_t{1}) - 1];
+            };
+            stats.mean = total / float(timing.count);
+            stats.p95 = percentile(95);
+            stats.p99 = percentile(99);
+            stats.max = sorted[timing.count - 1];
+        }
+        m_system_stats_dirty = false;
+    }
+    return m_system_stats;
+}
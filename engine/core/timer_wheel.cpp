@@ -0,0 +1,127 @@
+
+#include "timer_wheel.hpp"
+
+core::TimerWheel::TimerWheel () :
+    m_now(0),
+    m_active(0)
+{
+    std::fill(std::begin(m_slots), std::end(m_slots), Null);
+}
+
+void core::TimerWheel::reserve (std::uint32_t count)
+{
+    m_timers.reserve(count);
+    m_free.reserve(count);
+}
+
+core::TimerWheel::Handle core::TimerWheel::allocate ()
+{
+    std::uint32_t index;
+    if (! m_free.empty()) {
+        index = m_free.back();
+        m_free.pop_back();
+    } else {
+        index = std::uint32_t(m_timers.size());
+        // Generations start at 1, so that a zeroed handle is never valid
+        m_timers.push_back({});
+        m_timers.back().generation = 1;
+    }
+    auto& timer = m_timers[index];
+    timer.state = State::Allocated;
+    return {index, timer.generation};
+}
+
+void core::TimerWheel::schedule (Handle handle, std::uint64_t expiry, std::uint32_t interval, const gou::events::Event& event)
+{
+    Timer* timer = find(handle);
+    if (timer == nullptr || timer->state != State::Allocated) {
+        return;
+    }
+    timer->event = event;
+    timer->expiry = expiry;
+    timer->interval = interval;
+    // Ticks up to and including now have already been expired, so the soonest a timer can expire is the next tick
+    link(handle.index, m_now + 1);
+    ++m_active;
+}
+
+void core::TimerWheel::cancel (Handle handle)
+{
+    if (Timer* timer = find(handle)) {
+        if (timer->state == State::Scheduled) {
+            unlink(handle.index);
+        }
+        release(handle.index);
+    }
+}
+
+void core::TimerWheel::link (std::uint32_t index, std::uint64_t earliest)
+{
+    auto& timer = m_timers[index];
+    if (timer.expiry < earliest) {
+        timer.expiry = earliest;
+    }
+    // Timers beyond the range of the wheel are parked at its far end, they get re-linked each time they are cascaded
+    std::uint64_t delta = std::min(timer.expiry - m_now, MaxDelta);
+    std::uint64_t position = m_now + delta;
+    std::uint32_t level = 0;
+    while (level < Levels - 1 && delta >= (std::uint64_t{1} << (SlotBits * (level + 1)))) {
+        ++level;
+    }
+    timer.slot = level * Slots + std::uint32_t((position >> (SlotBits * level)) & SlotMask);
+    timer.prev = Null;
+    timer.next = m_slots[timer.slot];
+    if (timer.next != Null) {
+        m_timers[timer.next].prev = index;
+    }
+    m_slots[timer.slot] = index;
+    timer.state = State::Scheduled;
+}
+
+void core::TimerWheel::unlink (std::uint32_t index)
+{
+    auto& timer = m_timers[index];
+    if (timer.prev != Null) {
+        m_timers[timer.prev].next = timer.next;
+    } else {
+        m_slots[timer.slot] = timer.next;
+    }
+    if (timer.next != Null) {
+        m_timers[timer.next].prev = timer.prev;
+    }
+}
+
+void core::TimerWheel::release (std::uint32_t index)
+{
+    auto& timer = m_timers[index];
+    if (timer.state == State::Scheduled) {
+        --m_active;
+    }
+    timer.state = State::Free;
+    ++timer.generation;
+    m_free.push_back(index);
+}
+
+void core::TimerWheel::cascade (std::uint32_t level)
+{
+    auto& head = m_slots[level * Slots + std::uint32_t((m_now >> (SlotBits * level)) & SlotMask)];
+    std::uint32_t index = head;
+    head = Null;
+    while (index != Null) {
+        const std::uint32_t next = m_timers[index].next;
+        // Timers expiring this very tick land in the level 0 slot that is about to be expired
+        link(index, m_now);
+        index = next;
+    }
+}
+
+core::TimerWheel::Timer* core::TimerWheel::find (Handle handle)
+{
+    if (handle.index < m_timers.size()) {
+        auto& timer = m_timers[handle.index];
+        if (timer.generation == handle.generation && timer.state != State::Free) {
+            return &timer;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <gou_engine.hpp>
+
+namespace core {
+
+    /**
+     * Hierarchical timer wheel, storing events to be emitted once a tick (milliseconds, frames, ...) is reached.
+     * Four levels of 256 slots cover 2^32 ticks, with each level being 256 times coarser than the one below it.
+     * Timers live in a slab and are linked into their slots intrusively (by index), so scheduling, cancelling and
+     * expiring a timer are all O(1) and never allocate, once the slab has grown large enough.
+     * Timers are cascaded down a level when the level below wraps around, so each timer is touched at most once per level.
+     * Not thread safe: the engine stages timers per thread and applies them all at once (see core::Engine::pumpEvents).
+     */
+    class TimerWheel {
+    public:
+        struct Handle {
+            std::uint32_t index;
+            std::uint32_t generation;
+        };
+
+        TimerWheel ();
+
+        // Pre-allocate space for 'count' timers
+        void reserve (std::uint32_t count);
+
+        // Reserve a timer, so that its handle can be given out before it is scheduled
+        Handle allocate ();
+
+        // Schedule a previously allocated timer to expire at 'expiry'. If 'interval' is not 0, it repeats every 'interval' ticks
+        void schedule (Handle handle, std::uint64_t expiry, std::uint32_t interval, const gou::events::Event& event);
+
+        // Cancel a timer, ignored if the timer has already expired or been cancelled
+        void cancel (Handle handle);
+
+        // Advance to 'tick', calling 'fire' with the event of every timer that expires on the way, in order of expiry
+        template <typename Fn> void advance (std::uint64_t tick, Fn&& fire) {
+            if (m_active == 0) {
+                // Nothing to expire, skip straight to the target tick
+                m_now = std::max(m_now, tick);
+                return;
+            }
+            while (m_now < tick) {
+                ++m_now;
+                // When a level wraps around, move the timers of the next slot of the level above it down into this level
+                for (std::uint32_t level = 1; level < Levels; ++level) {
+                    if (((m_now >> (SlotBits * (level - 1))) & SlotMask) != 0) {
+                        break;
+                    }
+                    cascade(level);
+                }
+                // Expire every timer in the current slot
+                auto& head = m_slots[m_now & SlotMask];
+                std::uint32_t index = head;
+                head = Null;
+                while (index != Null) {
+                    auto& timer = m_timers[index];
+                    const std::uint32_t next = timer.next;
+                    fire(timer.event);
+                    if (timer.interval != 0) {
+                        timer.expiry += timer.interval;
+                        link(index, m_now + 1);
+                    } else {
+                        release(index);
+                    }
+                    index = next;
+                }
+            }
+        }
+
+        // The last tick that was advanced to
+        std::uint64_t now () const { return m_now; }
+
+        // Number of scheduled timers
+        std::uint32_t active () const { return m_active; }
+
+    private:
+        static constexpr std::uint32_t Levels = 4;
+        static constexpr std::uint32_t SlotBits = 8;
+        static constexpr std::uint32_t Slots = 1 << SlotBits;
+        static constexpr std::uint32_t SlotMask = Slots - 1;
+        static constexpr std::uint64_t MaxDelta = (std::uint64_t{1} << (SlotBits * Levels)) - 1;
+        static constexpr std::uint32_t Null = ~std::uint32_t(0);
+
+        enum class State : std::uint32_t {
+            Free,
+            Allocated,
+            Scheduled,
+        };
+        struct Timer {
+            gou::events::Event event;
+            std::uint64_t expiry;
+            std::uint32_t interval;
+            std::uint32_t generation;
+            std::uint32_t prev;
+            std::uint32_t next;
+            std::uint32_t slot;
+            State state;
+        };
+
+        std::vector<Timer> m_timers;
+        std::vector<std::uint32_t> m_free;
+        std::uint32_t m_slots[Levels * Slots];
+        std::uint64_t m_now;
+        std::uint32_t m_active;
+
+        // Insert a timer into the slot for its expiry, overdue timers are moved to 'earliest'
+        void link (std::uint32_t index, std::uint64_t earliest);
+        // Remove a timer from its slot
+        void unlink (std::uint32_t index);
+        // Return a timer to the free list, invalidating its handle
+        void release (std::uint32_t index);
+        // Re-insert the timers of the current slot of 'level' into the levels below
+        void cascade (std::uint32_t level);
+        // Look up the timer for a handle, nullptr if the handle is stale
+        Timer* find (Handle handle);
+    };
+
+} // core::
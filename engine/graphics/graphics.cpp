@@ -7,6 +7,8 @@
 
 #include "renderer.hpp"
 
+#include <numeric>
+
 #ifdef DEBUG_BUILD
 void GLAPIENTRY opengl_messageCallback (GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, const void* userParam)
 {
@@ -160,8 +162,8 @@ gou::api::Renderer* graphics::init (core::Engine& engine, graphics::Sync*& state
     // Share sync object with engine
     state_sync = &renderer->state_sync;
 
-    // Setup window
-    windowChanged(renderer);
+    // Setup window, the render thread isn't running yet so this is safe to do from the engine thread
+    renderer->windowChanged({width, height});
 
     // Start render thread
     renderer->render_thread = SDL_CreateThread(render, "render", reinterpret_cast<void*>(renderer));
@@ -169,6 +171,46 @@ gou::api::Renderer* graphics::init (core::Engine& engine, graphics::Sync*& state
     return renderer;
 }
 
+// Sprites per culling chunk
+constexpr std::size_t CullingChunkSize = 4096;
+
+// Collect the indices of the sprites that intersect the frustum into render_api->visible_sprites, in render list order
+void cullSprites (graphics::RenderAPI* render_api, const math::Frustum& frustum, const Sprites& sprites)
+{
+    EASY_FUNCTION(profiler::colors::Orange300);
+    auto& visible = render_api->visible_sprites;
+    if (sprites.size() > CullingChunkSize) {
+        auto& flow = render_api->culling_flow;
+        flow.clear();
+        math::cullSpheres(flow, frustum, sprites.bounds(), sprites.size(), visible, render_api->culling_counts, CullingChunkSize);
+        render_api->engine.executor().run(flow).wait();
+    } else {
+        // Not worth the scheduling overhead
+        visible.resize(sprites.size());
+        visible.resize(math::cullSpheres(frustum, sprites.bounds(), 0, sprites.size(), visible.data()));
+    }
+    render_api->stats.sprites_tested = std::uint32_t(sprites.size());
+    render_api->stats.sprites_culled = std::uint32_t(sprites.size() - visible.size());
+}
+
+// Queue the visible sprites, sorted by layer, then draw state and then front to back
+void queueSprites (graphics::RenderAPI* render_api, const glm::mat4& projection_view, const Sprites& sprites)
+{
+    const auto& visible = render_api->visible_sprites;
+    // Rows of the matrix that give clip space z and w, for the sprites depth
+    const glm::vec4 z_row{projection_view[0][2], projection_view[1][2], projection_view[2][2], projection_view[3][2]};
+    const glm::vec4 w_row{projection_view[0][3], projection_view[1][3], projection_view[2][3], projection_view[3][3]};
+    render_api->sprite_queue.build(render_api->engine.executor(), visible.size(), [&](std::size_t begin, std::size_t end, graphics::DrawItem* items){
+        for (std::size_t item = begin; item < end; ++item) {
+            const std::uint32_t index = visible[item];
+            const glm::vec4 position{sprites.positions[0][index], sprites.positions[1][index], sprites.positions[2][index], 1.0f};
+            const float depth = glm::dot(z_row, position) / glm::dot(w_row, position) * 0.5f + 0.5f;
+            // All sprites share the texture array, the texture layer is per instance, so it doesn't need a bind
+            items[item] = {graphics::sort_key::make(std::uint32_t(sprites.layers[index].x), SpriteShader, 0, 0, depth), index};
+        }
+    });
+}
+
 int render (void* data) {
     using CM = gou::api::Module::CallbackMasks;
 
@@ -206,7 +248,7 @@ int render (void* data) {
 
         glm::mat4 projection_matrix;
         glm::vec4 viewport;
-        std::vector<Sprite> sprites;
+        std::vector<SDL_Event> input_events;
         
         // Sync with the engine, so that it knows the render thread is set up
         {
@@ -227,58 +269,52 @@ int render (void* data) {
             EASY_BLOCK("Rendering frame", profiler::colors::Teal100);
 
             /*********************************************************************/
-            /* Wait for engine to hand over exclusive access to engine state.
-            * Renderer will then access the ECS registry to gather all components needed for rengering,
-            * accumulate a render list and hand exclusive access back to the engine. The renderer will
-            * then asynchronously render from its locally owned render list.
+            /* Wait for the engine to publish a new render packet. The engine doesn't wait for the renderer:
+            * it publishes into a triple buffer and carries on, the renderer always renders the newest packet.
+            * Only if modules have onPrepareRender hooks does the engine hand over exclusive access to its
+            * state, so that they can safely gather data from it, and wait for it back.
             *********************************************************************/
             {
-                EASY_BLOCK("Renderer waiting for exclusive access to engine", profiler::colors::Red100);
-                // Wait for exclusive access to engine state
+                EASY_BLOCK("Renderer waiting for render data", profiler::colors::Red100);
                 std::unique_lock<std::mutex> lock(state_sync.state_mutex);
-                {
-                    cv.wait(lock, [&state_sync](){ return state_sync.owner == graphics::Sync::Owner::Renderer; });
-                }
-                EASY_END_BLOCK;
-
-                // Let Dear ImGui process events from event queue
-                handleImGuiEvents(engine);
-
-                EASY_BLOCK("Collecting render data", profiler::colors::Red300);
-                
-                // Call onPrepareRender during the critical section, before performing any rendering
-                engine.callModuleHook<CM::PREPARE_RENDER>();
-
-                // Gather render data into render list
-                entt::registry& registry = render_api->engine.registry(gou::api::Registry::Runtime);
-
-                sprites.clear();
-                registry.view<components::graphics::Sprite, components::Position>(entt::exclude<components::Transform>).each([&sprites](const auto, const auto& position) {
-                    sprites.emplace_back(Sprite{position.point, glm::vec3(0.0f), glm::vec3(1.0f)});
-                });
-                registry.view<components::graphics::Sprite, components::Position, components::Transform>().each([&sprites](const auto, const auto& position, const auto& transform) {
-                    sprites.emplace_back(Sprite{position.point, transform.rotation, transform.scale});
+                cv.wait(lock, [&state_sync, render_api, &running](){
+                    return state_sync.owner == graphics::Sync::Owner::Renderer || render_api->packets.pending() || ! running.load();
                 });
+                EASY_END_BLOCK;
+                if (state_sync.owner == graphics::Sync::Owner::Renderer) {
+                    EASY_BLOCK("Preparing render", profiler::colors::Red300);
+                    // Call onPrepareRender during the critical section, before performing any rendering
+                    engine.callModuleHook<CM::PREPARE_RENDER>();
+                    // Hand exclusive access back to engine
+                    state_sync.owner = graphics::Sync::Owner::Engine;
+                    lock.unlock();
+                    cv.notify_one();
+                }
+            }
+            render_api->packets.update();
+            const auto& packet = render_api->packets.front();
 
-                // Gather render data, if there is any
-                if (render_api->dirty.exchange(false)) { // Only data set from engine thread context needs to set dirty and be gathered here
-                    if (render_api->window_changed) {
-                        render_api->windowChanged();
-                        render_api->window_changed = false;
+            // Let Dear ImGui process events from event queue
+            {
+                std::scoped_lock<std::mutex> lock(render_api->input_events_mutex);
+                std::swap(input_events, render_api->input_events);
+            }
+            handleImGuiEvents(input_events);
+            input_events.clear();
+
+            /*
+             * The window size is the only state the viewport depends on that the engine thread changes, and it comes with the packet,
+             * so nothing here needs the state lock. A packet that was never published has no size and is ignored.
+             */
+            if (packet.resolution != render_api->resolution() && packet.resolution.x > 0 && packet.resolution.y > 0) {
+                render_api->windowChanged(packet.resolution);
 #ifndef WITHOUT_IMGUI
-                        viewport = render_api->viewport();
-                        ImGui::GetIO().DisplaySize = ImVec2(viewport.z, viewport.w);
+                ImGui::GetIO().DisplaySize = ImVec2(float(packet.resolution.x), float(packet.resolution.y));
 #endif
-                    }
-                    viewport = render_api->viewport();
-                    projection_matrix = render_api->projectionMatrix();
-                }
-
-                // Hand exclusive access back to engine
-                state_sync.owner = graphics::Sync::Owner::Engine;
-                lock.unlock();
-                cv.notify_one();
             }
+            // Modules may also have changed the viewport from their render hooks, which run on this thread
+            viewport = render_api->viewport();
+            projection_matrix = render_api->projectionMatrix();
             // Now render frame from render list
             /*********************************************************************/
             EASY_BLOCK("Rendering", profiler::colors::Orange100);
@@ -290,7 +326,9 @@ int render (void* data) {
             glm::mat4 view_matrix = glm::lookAt(camera, glm::vec3{camera.x, camera.y, camera.z - 1.0f}, glm::vec3{0.0f, 1.0f, 0.0f});;
             glm::mat4 projection_view_matrix = projection_matrix * view_matrix;
 
-            // auto frustum = math::frustum(projection_view_matrix);
+            // Only sprites at least partially inside the view frustum are submitted
+            cullSprites(render_api, math::frustum(projection_view_matrix), packet.sprites);
+            queueSprites(render_api, projection_view_matrix, packet.sprites);
 
             {
                 EASY_BLOCK("Clearing viewport", profiler::colors::Orange200);
@@ -305,7 +343,9 @@ int render (void* data) {
             // Game Rendering here
             {
                 EASY_BLOCK("Rendering scene", profiler::colors::Orange200);
-                run (projection_view_matrix, sprites);
+                render_api->stats.state_changes = 0;
+                render_api->stats.draw_calls = 0;
+                run (projection_view_matrix, viewport, packet.sprites, render_api->sprite_queue, render_api->stats);
             }
 
             // Call module hook onAfterRender after rendering the frame
@@ -332,11 +372,129 @@ int render (void* data) {
     return 0;
 }
 
-void graphics::windowChanged(gou::api::Renderer* render_api)
+// Entities per render data extraction chunk
+constexpr std::size_t ExtractionChunkSize = 1024;
+
+void graphics::publish (gou::api::Renderer* render_api, tf::Executor& executor, std::uint64_t frame)
 {
+    EASY_FUNCTION(profiler::colors::Red300);
     auto api = static_cast<graphics::RenderAPI*>(render_api);
-    api->window_changed = true;
-    api->dirty.store(true);
+    auto& engine = api->engine;
+    entt::registry& registry = engine.registry(gou::api::Registry::Runtime);
+
+    // Gather render data into the packets render list, the slot is reused so its storage is kept from previous frames
+    auto& packet = api->packets.back();
+    packet.frame = frame;
+    packet.resolution = {int(entt::monostate<"graphics/resolution/width"_hs>()), int(entt::monostate<"graphics/resolution/height"_hs>())};
+    auto& sprites = packet.sprites;
+
+    // In fixed-tick mode, blend between the previous and the current tick, entities without a previous tick are drawn as they are
+    const float alpha = engine.interpolationAlpha();
+    // Fetched here, as the workers must not go through the registry: looking up a storage that doesn't exist yet creates it
+    auto layers = registry.view<const components::graphics::Layer>();
+    auto add_sprite = [&engine, &layers, &sprites, alpha](std::size_t index, const auto entity, const components::Position& position, const components::Transform* transform) {
+        const auto previous = engine.previousState(entity);
+        const glm::vec3 point = previous ? glm::mix(previous->point, position.point, alpha) : position.point;
+        // Sprites don't have textures yet, so they all use the first layer of the texture array
+        const glm::vec2 layer{layers.contains(entity) ? float(layers.get<const components::graphics::Layer>(entity).layer) : 0.0f, 0.0f};
+        if (transform == nullptr) {
+            sprites.set(index, point, glm::vec3(0.0f), glm::vec3(1.0f), layer);
+            return;
+        }
+        if (previous && previous->has_transform) {
+            sprites.set(index, point, glm::mix(previous->rotation, transform->rotation, alpha), glm::mix(previous->scale, transform->scale, alpha), layer);
+        } else {
+            sprites.set(index, point, transform->rotation, transform->scale, layer);
+        }
+    };
+
+    /*
+     * Extraction runs in four steps: count the sprites in each chunk of entities, size the render list once from the counts,
+     * fill each chunks slice of the list and compute the sprites model matrices. Everything but the sizing is spread across
+     * the workers, and since every chunk knows where its sprites go up front, they can be written in parallel without the
+     * render list ever reallocating.
+     */
+    auto untransformed = registry.view<components::graphics::Sprite, components::Position>(entt::exclude<components::Transform>);
+    auto transformed = registry.view<components::graphics::Sprite, components::Position, components::Transform>();
+    // Chunks are taken from each views smallest storage, entities that don't match the view are skipped
+    const auto& untransformed_entities = untransformed.handle();
+    const auto& transformed_entities = transformed.handle();
+    const std::size_t untransformed_chunks = (untransformed_entities.size() + ExtractionChunkSize - 1) / ExtractionChunkSize;
+    const std::size_t chunks = untransformed_chunks + (transformed_entities.size() + ExtractionChunkSize - 1) / ExtractionChunkSize;
+    auto& offsets = api->extraction_offsets;
+    offsets.assign(chunks + 1, 0);
+
+    // Call fn(entity, position, transform or nullptr) for every entity of a chunk that has a sprite
+    auto for_each_in_chunk = [&](std::size_t chunk, auto&& fn) {
+        const bool is_transformed = chunk >= untransformed_chunks;
+        const auto& entities = is_transformed ? transformed_entities : untransformed_entities;
+        const std::size_t begin = (is_transformed ? chunk - untransformed_chunks : chunk) * ExtractionChunkSize;
+        const std::size_t end = std::min(begin + ExtractionChunkSize, entities.size());
+        for (auto index = begin; index < end; ++index) {
+            const auto entity = entities.data()[index];
+            if (is_transformed) {
+                if (transformed.contains(entity)) {
+                    fn(entity, transformed.get<components::Position>(entity), &transformed.get<components::Transform>(entity));
+                }
+            } else if (untransformed.contains(entity)) {
+                fn(entity, untransformed.get<components::Position>(entity), nullptr);
+            }
+        }
+    };
+    auto count_chunk = [&](std::size_t chunk) {
+        std::size_t count = 0;
+        for_each_in_chunk(chunk, [&count](const auto, const auto&, const auto*){ ++count; });
+        offsets[chunk + 1] = count;
+    };
+    auto size_render_list = [&]() {
+        std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+        sprites.resize(offsets.back());
+    };
+    auto fill_chunk = [&](std::size_t chunk) {
+        std::size_t index = offsets[chunk];
+        for_each_in_chunk(chunk, [&index, &add_sprite](const auto entity, const auto& position, const auto* transform){
+            add_sprite(index++, entity, position, transform);
+        });
+    };
+
+    if (chunks > 1) {
+        auto& flow = api->extraction_flow;
+        flow.clear();
+        tf::Task count = flow.for_each_index(std::size_t{0}, chunks, std::size_t{1}, count_chunk).name("Render/count");
+        tf::Task size = flow.emplace(size_render_list).name("Render/size");
+        tf::Task fill = flow.for_each_index(std::size_t{0}, chunks, std::size_t{1}, fill_chunk).name("Render/fill");
+        tf::Task transform = flow.emplace([&sprites](tf::Subflow& subflow){
+            // The number of sprites is only known once the list has been sized, so the chunks are spawned at runtime
+            math::computeTransforms(subflow, sprites.streams(), sprites.size(), sprites.transforms.data());
+        }).name("Render/transform");
+        count.precede(size);
+        size.precede(fill);
+        fill.precede(transform);
+        executor.run(flow).wait();
+    } else {
+        // Not worth the scheduling overhead
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            count_chunk(chunk);
+        }
+        size_render_list();
+        for (std::size_t chunk = 0; chunk < chunks; ++chunk) {
+            fill_chunk(chunk);
+        }
+        math::computeTransforms(sprites.streams(), 0, sprites.size(), sprites.transforms.data());
+    }
+
+    {
+        std::scoped_lock<std::mutex> lock(api->input_events_mutex);
+        const auto& input_events = engine.inputEvents();
+        api->input_events.insert(api->input_events.end(), input_events.begin(), input_events.end());
+    }
+    api->packets.publish();
+
+    // Wake the render thread. The lock is only taken so that the wakeup can't slip in between it checking for a packet and going to sleep
+    {
+        std::scoped_lock<std::mutex> lock(api->state_sync.state_mutex);
+    }
+    api->state_sync.sync_cv.notify_one();
 }
 
 void graphics::term (gou::api::Renderer* render_api)
@@ -13,6 +13,10 @@ namespace gou::api {
     class Renderer;
 }
 
+namespace tf {
+    class Executor;
+}
+
 namespace graphics {
 
     struct Sync {
@@ -25,7 +29,7 @@ namespace graphics {
     };
 
     gou::api::Renderer* init (core::Engine&, graphics::Sync*&, ImGuiContext*&);
-    void windowChanged(gou::api::Renderer*);
+    void publish (gou::api::Renderer*, tf::Executor&, std::uint64_t frame);
     void term (gou::api::Renderer*);
 
 } // graphics::
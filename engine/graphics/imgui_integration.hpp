@@ -32,9 +32,9 @@ void initImGui (graphics::RenderAPI* render_api)
     ImGui_ImplOpenGL3_Init("#version 450");
 }
 
-void handleImGuiEvents (core::Engine& engine)
+void handleImGuiEvents (const std::vector<SDL_Event>& input_events)
 {
-    for (const auto& event : engine.inputEvents()) {
+    for (const auto& event : input_events) {
         ImGui_ImplSDL2_ProcessEvent(&event);
     }
 }
@@ -72,7 +72,7 @@ void destroyImGuiContext ()
 
 ImGuiContext* createImGuiContext() { return nullptr; }
 void initImGui (graphics::RenderAPI*) {}
-void handleImGuiEvents (core::Engine&) {}
+void handleImGuiEvents (const std::vector<SDL_Event>&) {}
 void newImGuiFrame (graphics::RenderAPI*) {}
 void endImGuiFrame (graphics::RenderAPI*) {}
 void destroyImGuiContext () {}
@@ -154,6 +154,12 @@ namespace graphics {
             glDrawElements(GL_TRIANGLES, m_num_indices, GL_UNSIGNED_INT, 0);
         }
 
+        // Per-instance attributes start from 'first_instance' rather than the start of their buffers
+        void drawIndexedInstanced (unsigned int instances, unsigned int first_instance=0) const {
+            glBindVertexArray(m_vao);
+            glDrawElementsInstancedBaseInstance(GL_TRIANGLES, m_num_indices, GL_UNSIGNED_INT, 0, GLsizei(instances), first_instance);
+        }
+
         void drawIndexed (const std::vector<GLushort>& indices, BufferUsage usage=BufferUsage::StreamDraw) const {
             glBindVertexArray(m_vao);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ebo);
@@ -16,15 +16,13 @@ void graphics::RenderAPI::setViewport (const glm::vec4& rect)
 {
     if (m_rect != rect) {
         m_rect = rect;
-        const int height = entt::monostate<"graphics/resolution/height"_hs>();
         m_viewport = {
             // Bottom left corner of viewable area
-            rect.x, height - (rect.y + rect.w),
+            rect.x, m_resolution.y - (rect.y + rect.w),
             // Size of viewable area
             rect.z, rect.w,
         };
         updateProjectionMatrix();
-        dirty.store(true);
     }
 }
 
@@ -38,12 +36,11 @@ void graphics::RenderAPI::updateProjectionMatrix ()
     // m_projection_matrix = glm::ortho(m_viewport.x, m_viewport.x + m_viewport.z, m_viewport.y + m_viewport.w, m_viewport.y, near_distance, far_distance);
 }
 
-// This method can be called form the engine threads
-void graphics::RenderAPI::windowChanged ()
+// The resolution is passed in rather than read from the config, as the engine thread writes the config when the window is resized
+void graphics::RenderAPI::windowChanged (const glm::ivec2& resolution)
 {
-    const int width = entt::monostate<"graphics/resolution/width"_hs>();
-    const int height = entt::monostate<"graphics/resolution/height"_hs>();
-    m_viewport = glm::vec4(0, 0, width, height);
+    m_resolution = resolution;
+    m_viewport = glm::vec4(0, 0, resolution.x, resolution.y);
     m_rect = m_viewport;
     updateProjectionMatrix();
 }
@@ -7,8 +7,11 @@
 
 #include <atomic>
 #include <imgui.h>
+#include <taskflow/taskflow.hpp>
 
 #include "graphics.hpp"
+#include "renderer.hpp"
+#include "memory/triple_buffer.hpp"
 
 namespace core {
     class Engine;
@@ -16,6 +19,13 @@ namespace core {
 
 namespace graphics {
 
+    // Snapshot of the engine state needed to render a frame, published by the engine at the end of each frame
+    struct RenderPacket {
+        std::uint64_t frame;
+        glm::ivec2 resolution{0, 0}; // Window size, the viewport and projection are recalculated on the render thread when it changes
+        Sprites sprites;
+    };
+
     /*
      * This class is the API provided for other parts of the engine (especially modules) to interact with
      * the graphics subsystem. It is also the container for internal context data for.
@@ -38,8 +48,20 @@ namespace graphics {
         std::atomic_bool running = true;
         SDL_Thread* render_thread;
         Sync state_sync;
-        std::atomic_bool dirty = false;
-        bool window_changed = false;
+        // Written by the engine thread only, read by the render thread only
+        memory::TripleBuffer<RenderPacket> packets;
+        // Engine thread only: render data extraction graph and the offset of each chunks sprites in the render list
+        tf::Taskflow extraction_flow;
+        std::vector<std::size_t> extraction_offsets;
+        // Input events for Dear ImGui accumulate until the render thread takes them, as it may skip packets
+        std::mutex input_events_mutex;
+        std::vector<SDL_Event> input_events;
+        // Render thread only: culling graph, the indices of the sprites that survived culling, their draw queue and the frames counters
+        tf::Taskflow culling_flow;
+        std::vector<std::uint32_t> visible_sprites;
+        std::vector<std::size_t> culling_counts;
+        RenderQueue sprite_queue;
+        gou::api::RenderStats stats = {};
 
         /**********************************************************************
          * Safe to call from anywhere
@@ -54,24 +76,39 @@ namespace graphics {
         }
 
         /**********************************************************************
-         * Below functions must hold the state_sync lock
-         */ 
+         * Below functions should only be used in render thread context (or before the render thread starts)
+         */
         const glm::vec4& viewport () const { return m_viewport; }
         const glm::mat4& projectionMatrix () const { return m_projection_matrix; }
+        const glm::ivec2& resolution () const { return m_resolution; }
 
-        void windowChanged ();
+        void windowChanged (const glm::ivec2& resolution);
 
-        /**********************************************************************
-         * Below functions should only be used in render thread context
-         */
         void setViewport (const glm::vec4& rect) final;
+        const gou::api::RenderStats& renderStats () const final { return stats; }
 
     private:
         glm::vec4 m_viewport;
         glm::mat4 m_projection_matrix;
         glm::vec4 m_rect;
+        glm::ivec2 m_resolution;
 
         void updateProjectionMatrix ();
     };
 
+    /*
+     * Stand-in for the RenderAPI when the engine runs headless: there is no window, GL context or render thread,
+     * so there is nothing to render to, but modules can still query the renderer.
+     */
+    class HeadlessRenderer : public gou::api::Renderer
+    {
+    public:
+        bool hasImGui () const final { return false; }
+        void setViewport (const glm::vec4&) final {}
+        const gou::api::RenderStats& renderStats () const final { return m_stats; }
+
+    private:
+        gou::api::RenderStats m_stats = {};
+    };
+
 } // graphics::
@@ -0,0 +1,145 @@
+
+#include "render_queue.hpp"
+
+void graphics::RenderQueue::build (tf::Executor& executor, std::size_t count, const FillFn& fill)
+{
+    EASY_FUNCTION(profiler::colors::Orange300);
+    m_buffers[0].resize(count);
+    m_buffers[1].resize(count);
+    m_chunks = (count + ChunkSize - 1) / ChunkSize;
+    m_histograms.resize(m_chunks);
+    m_first_keys.resize(m_chunks);
+    m_varying.resize(m_chunks);
+
+    if (m_chunks <= 1) {
+        // Not worth the scheduling overhead
+        for (std::size_t chunk = 0; chunk < m_chunks; ++chunk) {
+            fillChunk(chunk, fill);
+        }
+        plan();
+        for (unsigned pass = 0; pass < Passes; ++pass) {
+            if (m_sources[pass] >= 0) {
+                for (std::size_t chunk = 0; chunk < m_chunks; ++chunk) {
+                    histogram(pass, chunk);
+                }
+                prefixSum();
+                for (std::size_t chunk = 0; chunk < m_chunks; ++chunk) {
+                    scatter(pass, chunk);
+                }
+            }
+        }
+        finish();
+        return;
+    }
+
+    // Which passes are needed is only known once the keys exist, so every pass is in the graph and skipped ones do nothing
+    m_flow.clear();
+    tf::Task previous = m_flow.for_each_index(std::size_t{0}, m_chunks, std::size_t{1}, [this, &fill](std::size_t chunk){
+        fillChunk(chunk, fill);
+    }).name("Render queue/fill");
+    tf::Task planned = m_flow.emplace([this](){ plan(); }).name("Render queue/plan");
+    previous.precede(planned);
+    previous = planned;
+    for (unsigned pass = 0; pass < Passes; ++pass) {
+        tf::Task counted = m_flow.for_each_index(std::size_t{0}, m_chunks, std::size_t{1}, [this, pass](std::size_t chunk){
+            if (m_sources[pass] >= 0) {
+                histogram(pass, chunk);
+            }
+        }).name("Render queue/histogram");
+        tf::Task summed = m_flow.emplace([this, pass](){
+            if (m_sources[pass] >= 0) {
+                prefixSum();
+            }
+        }).name("Render queue/prefix sum");
+        tf::Task scattered = m_flow.for_each_index(std::size_t{0}, m_chunks, std::size_t{1}, [this, pass](std::size_t chunk){
+            if (m_sources[pass] >= 0) {
+                scatter(pass, chunk);
+            }
+        }).name("Render queue/scatter");
+        previous.precede(counted);
+        counted.precede(summed);
+        summed.precede(scattered);
+        previous = scattered;
+    }
+    tf::Task finished = m_flow.emplace([this](){ finish(); }).name("Render queue/finish");
+    previous.precede(finished);
+    executor.run(m_flow).wait();
+}
+
+void graphics::RenderQueue::fillChunk (std::size_t chunk, const FillFn& fill)
+{
+    const std::size_t begin = chunk * ChunkSize;
+    const std::size_t end = std::min(begin + ChunkSize, m_buffers[0].size());
+    fill(begin, end, m_buffers[0].data());
+    const std::uint64_t first = m_buffers[0][begin].key;
+    std::uint64_t varying = 0;
+    for (std::size_t index = begin; index < end; ++index) {
+        varying |= m_buffers[0][index].key ^ first;
+    }
+    m_first_keys[chunk] = first;
+    m_varying[chunk] = varying;
+}
+
+void graphics::RenderQueue::plan ()
+{
+    std::uint64_t varying = 0;
+    for (std::size_t chunk = 0; chunk < m_chunks; ++chunk) {
+        varying |= m_varying[chunk] | (m_first_keys[chunk] ^ m_first_keys[0]);
+    }
+    // Each pass that isn't skipped reads from the buffer the previous one wrote to
+    int source = 0;
+    for (unsigned pass = 0; pass < Passes; ++pass) {
+        if (((varying >> (8 * pass)) & 0xff) != 0) {
+            m_sources[pass] = source;
+            source ^= 1;
+        } else {
+            m_sources[pass] = -1;
+        }
+    }
+    m_result = source;
+}
+
+void graphics::RenderQueue::histogram (unsigned pass, std::size_t chunk)
+{
+    const auto& items = m_buffers[m_sources[pass]];
+    auto& counts = m_histograms[chunk];
+    counts.fill(0);
+    const std::size_t begin = chunk * ChunkSize;
+    const std::size_t end = std::min(begin + ChunkSize, items.size());
+    for (std::size_t index = begin; index < end; ++index) {
+        ++counts[(items[index].key >> (8 * pass)) & 0xff];
+    }
+}
+
+void graphics::RenderQueue::prefixSum ()
+{
+    // Turn the counts into the position each chunk writes its first item with a given byte to, chunks in order so the sort is stable
+    std::uint32_t offset = 0;
+    for (std::size_t digit = 0; digit < 256; ++digit) {
+        for (auto& counts : m_histograms) {
+            const std::uint32_t count = counts[digit];
+            counts[digit] = offset;
+            offset += count;
+        }
+    }
+}
+
+void graphics::RenderQueue::scatter (unsigned pass, std::size_t chunk)
+{
+    const auto& source = m_buffers[m_sources[pass]];
+    auto& target = m_buffers[m_sources[pass] ^ 1];
+    auto& offsets = m_histograms[chunk];
+    const std::size_t begin = chunk * ChunkSize;
+    const std::size_t end = std::min(begin + ChunkSize, source.size());
+    for (std::size_t index = begin; index < end; ++index) {
+        const auto& item = source[index];
+        target[offsets[(item.key >> (8 * pass)) & 0xff]++] = item;
+    }
+}
+
+void graphics::RenderQueue::finish ()
+{
+    if (m_result != 0) {
+        m_buffers[0].swap(m_buffers[1]);
+    }
+}
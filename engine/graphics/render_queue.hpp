@@ -0,0 +1,133 @@
+#pragma once
+
+#include <gou_engine.hpp>
+
+#include <taskflow/taskflow.hpp>
+
+#include <array>
+#include <functional>
+
+namespace graphics {
+
+    /**
+     * 64-bit draw sort keys. Fields are packed from most to least significant, so that sorting by key draws layers in order and,
+     * within a layer, keeps draws that share a shader, then a material, then a texture together, ordering them front to back.
+     */
+    namespace sort_key {
+        constexpr unsigned LayerBits = 8;
+        constexpr unsigned ShaderBits = 8;
+        constexpr unsigned MaterialBits = 12;
+        constexpr unsigned TextureBits = 12;
+        constexpr unsigned DepthBits = 24;
+        static_assert(LayerBits + ShaderBits + MaterialBits + TextureBits + DepthBits == 64, "Sort key fields must fill 64 bits");
+
+        constexpr unsigned DepthShift = 0;
+        constexpr unsigned TextureShift = DepthShift + DepthBits;
+        constexpr unsigned MaterialShift = TextureShift + TextureBits;
+        constexpr unsigned ShaderShift = MaterialShift + MaterialBits;
+        constexpr unsigned LayerShift = ShaderShift + ShaderBits;
+
+        constexpr std::uint64_t field (std::uint64_t value, unsigned bits, unsigned shift) {
+            return (value & ((std::uint64_t{1} << bits) - 1)) << shift;
+        }
+
+        // Depth is in [0, 1] from the near to the far plane, anything outside is clamped
+        inline std::uint64_t make (std::uint32_t layer, std::uint32_t shader, std::uint32_t material, std::uint32_t texture, float depth) {
+            const float max_depth = float((1u << DepthBits) - 1);
+            return field(layer, LayerBits, LayerShift)
+                | field(shader, ShaderBits, ShaderShift)
+                | field(material, MaterialBits, MaterialShift)
+                | field(texture, TextureBits, TextureShift)
+                | field(std::uint64_t(std::clamp(depth, 0.0f, 1.0f) * max_depth), DepthBits, DepthShift);
+        }
+
+        constexpr std::uint32_t shader (std::uint64_t key) { return std::uint32_t((key >> ShaderShift) & ((1u << ShaderBits) - 1)); }
+        constexpr std::uint32_t material (std::uint64_t key) { return std::uint32_t((key >> MaterialShift) & ((1u << MaterialBits) - 1)); }
+        constexpr std::uint32_t texture (std::uint64_t key) { return std::uint32_t((key >> TextureShift) & ((1u << TextureBits) - 1)); }
+    }
+
+    struct DrawItem {
+        std::uint64_t key;
+        std::uint32_t index; // Of the instance in the render list
+    };
+
+    /**
+     * Draw items sorted by key. Sorting is a least significant digit radix sort, a byte at a time, with the histogram and scatter
+     * steps of each pass spread across the executors workers. Bytes that are the same in every key are skipped, so in practice only
+     * the layer and depth bytes that actually vary are sorted on.
+     */
+    class RenderQueue {
+    public:
+        // The GPU state a draw depends on, as a mask of what changed since the previous draw
+        enum StateChange : unsigned {
+            Shader = 0x1,
+            Material = 0x2,
+            Texture = 0x4,
+        };
+        using FillFn = std::function<void(std::size_t begin, std::size_t end, DrawItem* items)>;
+
+        // Fill the queue with 'count' items, by calling fill for chunks of the queue in parallel, and sort them by key
+        void build (tf::Executor& executor, std::size_t count, const FillFn& fill);
+
+        std::size_t size () const { return m_buffers[0].size(); }
+        const DrawItem& operator[] (std::size_t index) const { return m_buffers[0][index]; }
+
+        /**
+         * Walk the sorted queue, calling bind(key, changes) whenever the shader, material or texture differs from the previous
+         * item (always for the first item), and draw(first, count) for every run of consecutive items that share them.
+         * Adds the number of state changes and draw calls to the counters.
+         */
+        template <typename Bind, typename Draw>
+        void submit (Bind&& bind, Draw&& draw, std::uint32_t& state_changes, std::uint32_t& draw_calls) const {
+            const auto& items = m_buffers[0];
+            std::size_t first = 0;
+            for (std::size_t index = 0; index < items.size(); ++index) {
+                const std::uint64_t key = items[index].key;
+                unsigned changes = Shader | Material | Texture;
+                if (index > 0) {
+                    const std::uint64_t previous = items[index - 1].key;
+                    changes = (sort_key::shader(key) != sort_key::shader(previous) ? Shader : 0)
+                        | (sort_key::material(key) != sort_key::material(previous) ? Material : 0)
+                        | (sort_key::texture(key) != sort_key::texture(previous) ? Texture : 0);
+                    if (changes == 0) {
+                        continue;
+                    }
+                    draw(first, index - first);
+                    ++draw_calls;
+                    first = index;
+                }
+                bind(key, changes);
+                state_changes += std::uint32_t(((changes & Shader) ? 1 : 0) + ((changes & Material) ? 1 : 0) + ((changes & Texture) ? 1 : 0));
+            }
+            if (first < items.size()) {
+                draw(first, items.size() - first);
+                ++draw_calls;
+            }
+        }
+
+    private:
+        static constexpr std::size_t ChunkSize = 16384;
+        static constexpr unsigned Passes = 8;
+        using Histogram = std::array<std::uint32_t, 256>;
+
+        // Sorted items end up in the first buffer, the second is scratch space for the passes
+        std::vector<DrawItem> m_buffers[2];
+        std::vector<Histogram> m_histograms;
+        // Per chunk: the key of the first item and the bits that differ from it in any of the chunks keys
+        std::vector<std::uint64_t> m_first_keys;
+        std::vector<std::uint64_t> m_varying;
+        // Per pass: which buffer it reads from, or -1 if it is skipped
+        int m_sources[Passes];
+        int m_result;
+        std::size_t m_chunks;
+        tf::Taskflow m_flow;
+
+        void fillChunk (std::size_t chunk, const FillFn& fill);
+        void plan ();
+        void histogram (unsigned pass, std::size_t chunk);
+        void prefixSum ();
+        void scatter (unsigned pass, std::size_t chunk);
+        void finish ();
+    };
+
+} // graphics::
@@ -2,30 +2,90 @@
 #include "gou_engine.hpp"
 
 #include "mesh.hpp"
+#include "streaming_buffer.hpp"
+#include "visibility_buffer.hpp"
+
+#include <cstring>
 
 graphics::Shader g_shader;
+graphics::Shader g_resolve_shader;
 graphics::Mesh g_mesh;
+graphics::VisibilityBuffer g_visibility;
+// Core profile needs a vertex array bound to draw, even one without attributes, as the full screen triangle is
+GLuint empty_vao;
+// Sprites have no textures yet, so they all sample this single texel, the color they used to be drawn in
+GLuint default_albedo;
 
-GLuint matrices_ubo;
+// Texture units of the resolve pass
+enum TextureUnits : GLuint {
+    VisibilityUnit,
+    DepthUnit,
+    AlbedoUnit,
+};
 
-void init ()
+// Indexed by the shader id of the sort keys
+graphics::Shader* g_shaders[] = {&g_shader};
+
+// Per-instance sprite data, interleaved so that all attributes of an instance share one buffer and one base instance.
+// Read as vertex attributes by the geometry pass and as a storage buffer by the resolve pass, padded to match its std430 layout
+struct SpriteInstance {
+    math::Matrix4x3 transform;
+    glm::vec2 layer;
+    glm::vec2 padding;
+};
+static_assert(sizeof(SpriteInstance) == 64, "SpriteInstance must match the std430 layout of SpriteInstance in resolve.frag.glsl");
+
+constexpr std::size_t InitialInstances = 1024;
+
+graphics::StreamingBuffer matrices_buffer;
+graphics::StreamingBuffer instances_buffer;
+
+// Point the per-instance attributes at the instance buffer, needed again whenever it is reallocated
+void bindInstanceAttributes ()
 {
-    // Setup UBO for matrices
-    glGenBuffers(1, &matrices_ubo);
-    glBindBuffer(GL_UNIFORM_BUFFER, matrices_ubo);
-    glBufferData(GL_UNIFORM_BUFFER, 1 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    g_mesh.bind();
+    glBindBuffer(GL_ARRAY_BUFFER, instances_buffer.buffer());
+    for (GLuint row = 0; row < 3; ++row) {
+        glVertexAttribPointer(1 + row, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), reinterpret_cast<const void*>(offsetof(SpriteInstance, transform) + row * sizeof(glm::vec4)));
+    }
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), reinterpret_cast<const void*>(offsetof(SpriteInstance, layer)));
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
 
-    // Connect UBO to binding point 0
-    glBindBufferRange(GL_UNIFORM_BUFFER, 0, matrices_ubo, 0, 1 * sizeof(glm::mat4));
+void init ()
+{
+    // Matrices are streamed into a new region every frame, each region must start at an offset the UBO binding accepts
+    GLint uniform_alignment;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniform_alignment);
+    matrices_buffer.create(2 * sizeof(glm::mat4), std::size_t(uniform_alignment));
 
+    // The geometry pass only writes the visibility buffer, texturing and shading happen once per pixel in the resolve pass
     g_shader = graphics::Shader::load({
-        {graphics::Shader::Types::Vertex, "shaders/passthru.vert.glsl"},
-        {graphics::Shader::Types::Fragment, "shaders/passthru.frag.glsl"},
+        {graphics::Shader::Types::Vertex, "shaders/sprite.vert.glsl"},
+        {graphics::Shader::Types::Fragment, "shaders/visibility.frag.glsl"},
+    });
+    g_resolve_shader = graphics::Shader::load({
+        {graphics::Shader::Types::Vertex, "shaders/fullscreen.vert.glsl"},
+        {graphics::Shader::Types::Fragment, "shaders/resolve.frag.glsl"},
     });
 
     // Connect shader UBO blocks to binding point 0
-    g_shader.bindUnfiromBlock("Matrices", 0);
+    g_shader.bindUniformBlock("Matrices"_hs, 0);
+    g_resolve_shader.bindUniformBlock("Matrices"_hs, 0);
+    g_resolve_shader.use();
+    g_resolve_shader.uniform("visibility"_hs).set(int(VisibilityUnit));
+    g_resolve_shader.uniform("visibility_depth"_hs).set(int(DepthUnit));
+    g_resolve_shader.uniform("textures_albedo"_hs).set(int(AlbedoUnit));
+    glUseProgram(0);
+
+    glGenVertexArrays(1, &empty_vao);
+    const std::uint8_t albedo[4] = {255, 128, 51, 255};
+    glGenTextures(1, &default_albedo);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, default_albedo);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, GL_RGBA8, 1, 1, 1);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, albedo);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
 
     g_mesh.addVertexBuffer<glm::vec3>({
             {-0.5f,  0.5f, 0.0f}, // top left
@@ -34,37 +94,82 @@ void init ()
             {0.5f,  0.5f, 0.0f},  // top right
     });
     g_mesh.addIndexBuffer({0, 1, 2, 2, 3, 0});
-}
-
 
-namespace constants {
-    const float FULL_CIRCLE = glm::radians(360.0f);
+    // Per-instance sprite data is streamed into its own buffer each frame, attributes advance once per instance rather than per vertex.
+    // Regions are a whole number of instances, so that a regions first instance can be addressed with a base instance
+    instances_buffer.create(InitialInstances * sizeof(SpriteInstance), sizeof(SpriteInstance));
+    g_mesh.bind();
+    for (GLuint attribute = 1; attribute <= 4; ++attribute) {
+        glVertexAttribDivisor(attribute, 1);
+        glEnableVertexAttribArray(attribute);
+    }
+    bindInstanceAttributes();
 }
 
-
-void run (const glm::mat4 projection_view, std::vector<Sprite>& sprites)
+void run (const glm::mat4 projection_view, const glm::vec4& viewport, const Sprites& sprites, const graphics::RenderQueue& queue, gou::api::RenderStats& stats)
 {
-    glBindBuffer(GL_UNIFORM_BUFFER, matrices_ubo);
-    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection_view));
-    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    const glm::mat4 matrices[2] = {projection_view, glm::inverse(projection_view)};
+    std::memcpy(matrices_buffer.map(), matrices, sizeof(matrices));
+    glBindBufferRange(GL_UNIFORM_BUFFER, 0, matrices_buffer.buffer(), GLintptr(matrices_buffer.offset()), sizeof(matrices));
 
-    g_mesh.bind();
-    g_shader.use();
-    for (auto& sprite : sprites) {
-        auto model_matrix = glm::translate(glm::identity<glm::mat4>(), sprite.position);
-        model_matrix = glm::rotate(model_matrix, constants::FULL_CIRCLE * sprite.rotation.x, glm::vec3(1.0f, 0.0f, 0.0f));
-        model_matrix = glm::rotate(model_matrix, constants::FULL_CIRCLE * sprite.rotation.y, glm::vec3(0.0f, 1.0f, 0.0f));
-        model_matrix = glm::rotate(model_matrix, constants::FULL_CIRCLE * sprite.rotation.z, glm::vec3(0.0f, 0.0f, 1.0f));
-        model_matrix = glm::scale(model_matrix, sprite.scale);
-
-        g_shader.uniform("u_model_matrix").set(model_matrix);
-        g_mesh.drawIndexed();
+    if (queue.size() == 0) {
+        matrices_buffer.advance();
+        return;
     }
+
+    // Gather the queued sprites instance data straight into mapped memory, in queue order
+    if (instances_buffer.reserve(queue.size() * sizeof(SpriteInstance))) {
+        bindInstanceAttributes();
+    }
+    auto instances = static_cast<SpriteInstance*>(instances_buffer.map());
+    for (std::size_t instance = 0; instance < queue.size(); ++instance) {
+        const std::uint32_t index = queue[instance].index;
+        instances[instance] = {sprites.transforms[index], sprites.layers[index], {}};
+    }
+    const std::size_t base_instance = instances_buffer.offset() / sizeof(SpriteInstance);
+
+    // Geometry pass: every run of sprites that share a shader, material and texture is drawn with a single instanced draw call
+    g_visibility.resize(int(viewport.z), int(viewport.w));
+    g_visibility.bind();
+    queue.submit(
+        [](std::uint64_t key, unsigned changes) {
+            if (changes & graphics::RenderQueue::Shader) {
+                g_shaders[graphics::sort_key::shader(key)]->use();
+            }
+            // Sprites have no materials or textures of their own yet
+        },
+        [base_instance](std::size_t first, std::size_t count) {
+            g_mesh.drawIndexedInstanced(unsigned(count), unsigned(base_instance + first));
+        },
+        stats.state_changes, stats.draw_calls);
+
+    // Resolve pass: one full screen triangle into the viewport, pixels not covered by any sprite are discarded
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(GLint(viewport.x), GLint(viewport.y), GLsizei(viewport.z), GLsizei(viewport.w));
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instances_buffer.buffer());
+    g_visibility.bindTextures(VisibilityUnit, DepthUnit);
+    glActiveTexture(GL_TEXTURE0 + AlbedoUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, default_albedo);
+    glActiveTexture(GL_TEXTURE0);
+    g_resolve_shader.use();
+    g_resolve_shader.uniform("viewport"_hs).set(viewport);
+    glBindVertexArray(empty_vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+    ++stats.draw_calls;
+
+    matrices_buffer.advance();
+    instances_buffer.advance();
 }
 
 void term ()
 {
     g_shader.unload();
+    g_resolve_shader.unload();
     g_mesh.unload();
-    glDeleteBuffers(1, &matrices_ubo);
+    g_visibility.unload();
+    glDeleteVertexArrays(1, &empty_vao);
+    glDeleteTextures(1, &default_albedo);
+    matrices_buffer.unload();
+    instances_buffer.unload();
 }
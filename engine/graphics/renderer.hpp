@@ -1,15 +1,65 @@
 #pragma once
 
 #include <gou_engine.hpp>
+#include <gou/api.hpp>
 
 #include "shader.hpp"
+#include "render_queue.hpp"
+#include "utils/transforms.hpp"
+#include "utils/frustum.hpp"
 
-struct Sprite {
-    glm::vec3 position;
-    glm::vec3 rotation;
-    glm::vec3 scale;
+// The sprites of a frame, as a structure of arrays so that they can be processed in bulk
+struct Sprites {
+    std::vector<float> positions[3]; // x, y and z
+    std::vector<float> rotations[3]; // In turns around each axis
+    std::vector<float> scales[3];
+    std::vector<float> radii; // Of the bounding spheres used for culling
+    std::vector<glm::vec2> layers; // Layer and texture layer, uploaded to the GPU as-is
+    std::vector<math::Matrix4x3> transforms; // Model matrices computed from the above, uploaded to the GPU as-is
+
+    std::size_t size () const { return layers.size(); }
+
+    void resize (std::size_t count) {
+        for (std::size_t axis = 0; axis < 3; ++axis) {
+            positions[axis].resize(count);
+            rotations[axis].resize(count);
+            scales[axis].resize(count);
+        }
+        radii.resize(count);
+        layers.resize(count);
+        transforms.resize(count);
+    }
+
+    void set (std::size_t index, const glm::vec3& position, const glm::vec3& rotation, const glm::vec3& scale, const glm::vec2& layer) {
+        for (glm::length_t axis = 0; axis < 3; ++axis) {
+            positions[axis][index] = position[axis];
+            rotations[axis][index] = rotation[axis];
+            scales[axis][index] = scale[axis];
+        }
+        // The unit quad lies flat in its local xy plane, so its bounding sphere depends only on the x and y scale, whatever the rotation
+        radii[index] = 0.5f * std::sqrt(scale.x * scale.x + scale.y * scale.y);
+        layers[index] = layer;
+    }
+
+    math::TransformStreams streams () const {
+        return {
+            {positions[0].data(), positions[1].data(), positions[2].data()},
+            {rotations[0].data(), rotations[1].data(), rotations[2].data()},
+            {scales[0].data(), scales[1].data(), scales[2].data()},
+        };
+    }
+
+    math::SphereStreams bounds () const {
+        return {{positions[0].data(), positions[1].data(), positions[2].data()}, radii.data()};
+    }
 };
 
 void init ();
-void run (const glm::mat4 projection_matrix, std::vector<Sprite>& sprites);
+// Shader ids used in sort keys
+enum Shaders : std::uint32_t {
+    SpriteShader,
+};
+
+// Draw the sprites in the queue in order into a visibility buffer and resolve it into the viewport, adding the state changes and draw calls to 'stats'
+void run (const glm::mat4 projection_matrix, const glm::vec4& viewport, const Sprites& sprites, const graphics::RenderQueue& queue, gou::api::RenderStats& stats);
 void term ();
@@ -1,6 +1,10 @@
 
 #include "shader.hpp"
 
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
 GLuint compileAndAttach (GLuint shaderProgram, GLenum shaderType, const std::string& filename, const std::string& shaderSource)
 {
     GLuint shader = glCreateShader(shaderType);
@@ -37,17 +41,122 @@ GLuint compileAndAttach (GLuint shaderProgram, GLenum shaderType, const std::str
     return shader;
 }
 
+namespace binary_cache {
+    constexpr std::uint32_t Magic = 0x42554f47; // "GOUB"
+
+    struct Header {
+        std::uint32_t magic;
+        GLenum format;
+        std::uint64_t length;
+    };
+
+    std::uint64_t hash (std::uint64_t hash, const char* data, std::size_t length)
+    {
+        for (std::size_t index = 0; index < length; ++index) {
+            hash = (hash ^ std::uint8_t(data[index])) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // Binaries are only valid for the driver that produced them
+    const std::string& driver ()
+    {
+        static const std::string driver = [](){
+            std::string result;
+            for (GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+                auto value = reinterpret_cast<const char*>(glGetString(name));
+                result.append(value ? value : "").push_back('\n');
+            }
+            return result;
+        }();
+        return driver;
+    }
+
+    // Empty if the cache is disabled or the driver doesn't support program binaries
+    std::filesystem::path path (std::uint64_t key)
+    {
+        const std::string& directory = entt::monostate<"graphics/renderer/shader-cache"_hs>();
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        if (directory.empty() || formats == 0) {
+            return {};
+        }
+        return std::filesystem::path(directory) / fmt::format("{:016x}.bin", key);
+    }
+
+    bool load (GLuint program, const std::filesystem::path& filename)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        Header header;
+        if (! file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != Magic) {
+            return false;
+        }
+        std::string binary(header.length, '\0');
+        if (! file.read(binary.data(), std::streamsize(binary.size()))) {
+            return false;
+        }
+        glProgramBinary(program, header.format, binary.data(), GLsizei(binary.size()));
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        return linked != 0;
+    }
+
+    void save (GLuint program, const std::filesystem::path& filename)
+    {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return;
+        }
+        std::string binary(std::size_t(length), '\0');
+        Header header{Magic, 0, 0};
+        glGetProgramBinary(program, length, &length, &header.format, binary.data());
+        header.length = std::uint64_t(length);
+        std::error_code error;
+        std::filesystem::create_directories(filename.parent_path(), error);
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (error || ! file) {
+            spdlog::warn("Could not write shader cache file: {}", filename.string());
+            return;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(binary.data(), length);
+    }
+}
+
 graphics::Shader graphics::Shader::load (const spp::sparse_hash_map<graphics::Shader::Types, std::string>& shaderFiles)
 {
+    // Read the sources in a fixed order, so that the cache key doesn't depend on the maps iteration order
+    std::vector<std::pair<Types, std::string>> files(shaderFiles.begin(), shaderFiles.end());
+    std::sort(files.begin(), files.end(), [](const auto& a, const auto& b){ return helpers::enum_value(a.first) < helpers::enum_value(b.first); });
+    std::vector<std::string> sources;
+    std::uint64_t key = binary_cache::hash(0xcbf29ce484222325ull, binary_cache::driver().data(), binary_cache::driver().size());
+    for (const auto& [type, filename] : files) {
+        sources.push_back(helpers::readToString(filename));
+        const GLenum shader_type = helpers::enum_value(type);
+        key = binary_cache::hash(key, reinterpret_cast<const char*>(&shader_type), sizeof(shader_type));
+        key = binary_cache::hash(key, sources.back().data(), sources.back().size());
+    }
+    const auto cache_file = binary_cache::path(key);
+
     GLuint shaderProgram = glCreateProgram();
     std::array<GLuint, 5> shaders{GLuint(-1), GLuint(-1), GLuint(-1), GLuint(-1), GLuint(-1)};
+    if (! cache_file.empty() && binary_cache::load(shaderProgram, cache_file)) {
+        spdlog::debug("Loaded cached shader program: {}", cache_file.string());
+        Shader shader{shaderProgram, shaders};
+        shader.reflect();
+        return shader;
+    }
+
     auto shader_it = shaders.begin();
-    for (auto [type, filename] : shaderFiles) {
-        auto shaderType = helpers::enum_value(type);
-        auto source = helpers::readToString(filename);
-        GLuint shader = compileAndAttach(shaderProgram, shaderType, filename, source);
+    for (std::size_t index = 0; index < files.size(); ++index) {
+        auto shaderType = helpers::enum_value(files[index].first);
+        GLuint shader = compileAndAttach(shaderProgram, shaderType, files[index].second, sources[index]);
         *shader_it++ = shader;
     }
+    if (! cache_file.empty()) {
+        glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
     // Link the shader programs into one
     glLinkProgram(shaderProgram);
     int isLinked;
@@ -61,12 +170,49 @@ graphics::Shader graphics::Shader::load (const spp::sparse_hash_map<graphics::Sh
         char* shaderProgramInfoLog = new char[maxLength];
         glGetProgramInfoLog(shaderProgram, maxLength, &maxLength, shaderProgramInfoLog);
 
-        delete [] shaderProgramInfoLog;
         spdlog::critical("Linking shaders failed.\n{}", shaderProgramInfoLog);
+        delete [] shaderProgramInfoLog;
+    } else if (! cache_file.empty()) {
+        binary_cache::save(shaderProgram, cache_file);
     }
-    return {shaderProgram, shaders};
+    Shader shader{shaderProgram, shaders};
+    shader.reflect();
+    return shader;
 }
 
+void graphics::Shader::reflect ()
+{
+    GLint count = 0;
+    GLint max_length = 0;
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::string name(std::size_t(max_length) + 1, '\0');
+    for (GLint index = 0; index < count; ++index) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = GL_NONE;
+        glGetActiveUniform(programID, GLuint(index), GLsizei(name.size()), &length, &size, &type, name.data());
+        // Arrays are reported as name[0]
+        if (length > 3 && std::strncmp(name.data() + length - 3, "[0]", 3) == 0) {
+            length -= 3;
+            name[std::size_t(length)] = '\0';
+        }
+        const GLint location = glGetUniformLocation(programID, name.c_str());
+        // Members of uniform blocks have no location, they are set through the block
+        if (location != -1) {
+            uniforms[entt::hashed_string::value(name.data(), std::size_t(length))] = {location, type};
+        }
+    }
+
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(programID, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &max_length);
+    name.assign(std::size_t(max_length) + 1, '\0');
+    for (GLint index = 0; index < count; ++index) {
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(programID, GLuint(index), GLsizei(name.size()), &length, name.data());
+        uniform_blocks[entt::hashed_string::value(name.data(), std::size_t(length))] = GLuint(index);
+    }
+}
 
 void graphics::Shader::unload () const
 {
@@ -83,13 +229,24 @@ void graphics::Shader::unload () const
 
 void graphics::Shader::bindUnfiromBlock(const std::string& blockName, unsigned int bindingPoint) const
 {
-    GLuint location = glGetUniformBlockIndex(programID, blockName.c_str());
-    glUniformBlockBinding(programID, location, bindingPoint);
+    bindUniformBlock(entt::hashed_string::value(blockName.c_str(), blockName.size()), bindingPoint);
+}
+
+void graphics::Shader::bindUniformBlock(entt::hashed_string::hash_type block, unsigned int bindingPoint) const
+{
+    auto it = uniform_blocks.find(block);
+    if (it != uniform_blocks.end()) {
+        glUniformBlockBinding(programID, it->second, bindingPoint);
+    }
 }
 
 graphics::uniform graphics::Shader::uniform(const std::string& name) const
 {
-    return {
-        glGetUniformLocation(programID, name.c_str())
-    };
+    return uniform(entt::hashed_string::value(name.c_str(), name.size()));
+}
+
+graphics::uniform graphics::Shader::uniform(entt::hashed_string::hash_type name) const
+{
+    auto it = uniforms.find(name);
+    return it != uniforms.end() ? it->second : graphics::uniform{-1, GL_NONE};
 }
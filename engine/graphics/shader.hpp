@@ -8,7 +8,8 @@ namespace graphics {
     typedef GLuint buffer_t;
 
     struct uniform {
-        GLint location;
+        GLint location; // -1 if the shader has no such uniform, setting it is then a no-op
+        GLenum type;
 
         inline void set(float v) const {return glUniform1f(location, v);}
         inline void set(int v) const {return glUniform1i(location, v);}
@@ -32,16 +33,31 @@ namespace graphics {
 
         void unload() const;
         void bindUnfiromBlock(const std::string& blockName, unsigned int bindingPoint) const;
+        void bindUniformBlock(entt::hashed_string::hash_type block, unsigned int bindingPoint) const;
         graphics::uniform uniform(const std::string& name) const;
+        // Look up a uniform in the table reflected from the program when it was loaded, without querying GL
+        graphics::uniform uniform(entt::hashed_string::hash_type name) const;
         
         inline void use () const {
             glUseProgram(programID);
         }
 
+        /**
+         * Compile and link a program from GLSL source files.
+         * Linked programs are cached on disk (in graphics/renderer/shader-cache, if set) keyed by a hash of their sources and the
+         * driver, so that later runs load the binary with glProgramBinary instead of compiling. A stale or rejected binary falls
+         * back to compiling.
+         */
         static graphics::Shader load (const spp::sparse_hash_map<Types, std::string>& shaderFiles);
 
         GLuint programID;
         std::array<GLuint, 5> shaders;
+        // Active uniforms (outside of blocks) and uniform block indices, keyed by hashed name. Arrays are keyed by their plain name
+        spp::sparse_hash_map<entt::hashed_string::hash_type, graphics::uniform> uniforms;
+        spp::sparse_hash_map<entt::hashed_string::hash_type, GLuint> uniform_blocks;
+
+    private:
+        void reflect ();
     };
 
 } // graphics::
@@ -0,0 +1,97 @@
+
+#include "streaming_buffer.hpp"
+
+constexpr GLbitfield StorageFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+// How long to wait for the GPU to finish with a region before giving up on it, in nanoseconds
+constexpr GLuint64 FenceTimeout = 1000000000; // 1s
+
+// Wait for the GPU to pass a fence and delete it. The wait is bounded, so that a lost or hung context can't stall the render thread forever
+void wait_for_fence (GLsync& fence)
+{
+    EASY_BLOCK("Waiting for streaming buffer", profiler::colors::Red300);
+    // Flush, so that the fence is guaranteed to be submitted and the wait can't time out only because it never reached the GPU
+    const GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FenceTimeout);
+    if (result == GL_TIMEOUT_EXPIRED) {
+        spdlog::warn("Timed out waiting for streaming buffer fence");
+    } else if (result == GL_WAIT_FAILED) {
+        spdlog::error("Failed to wait for streaming buffer fence");
+    }
+    glDeleteSync(fence);
+    fence = nullptr;
+}
+
+void graphics::StreamingBuffer::create (std::size_t size, std::size_t alignment)
+{
+    m_alignment = alignment;
+    allocate(size);
+}
+
+void graphics::StreamingBuffer::unload ()
+{
+    release();
+}
+
+bool graphics::StreamingBuffer::reserve (std::size_t size)
+{
+    if (size <= m_region_size) {
+        return false;
+    }
+    // Regions of the old buffer may still be read by the GPU, release waits for them before unmapping it
+    release();
+    allocate(std::max(size, m_region_size * 2));
+    return true;
+}
+
+void* graphics::StreamingBuffer::map ()
+{
+    GLsync& fence = m_fences[m_region];
+    if (fence != nullptr) {
+        wait_for_fence(fence);
+    }
+    return m_mapped + offset();
+}
+
+void graphics::StreamingBuffer::advance ()
+{
+    GLsync& fence = m_fences[m_region];
+    if (fence != nullptr) {
+        // The region wasn't mapped since it was last fenced, so the old fence is redundant
+        glDeleteSync(fence);
+    }
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_region = (m_region + 1) % Regions;
+}
+
+void graphics::StreamingBuffer::allocate (std::size_t region_size)
+{
+    m_region_size = ((region_size + m_alignment - 1) / m_alignment) * m_alignment;
+    m_region = 0;
+    const GLsizeiptr total_size = GLsizeiptr(m_region_size * Regions);
+    // Bound to the copy target so that no binding used for drawing is disturbed
+    glGenBuffers(1, &m_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+    glBufferStorage(GL_COPY_WRITE_BUFFER, total_size, nullptr, StorageFlags);
+    m_mapped = static_cast<char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, total_size, StorageFlags));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    if (m_mapped == nullptr) {
+        throw std::runtime_error("Could not map streaming buffer");
+    }
+}
+
+void graphics::StreamingBuffer::release ()
+{
+    // A persistently mapped buffer must not be unmapped while the GPU is still reading from it
+    for (auto& fence : m_fences) {
+        if (fence != nullptr) {
+            wait_for_fence(fence);
+        }
+    }
+    if (m_buffer != 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_buffer);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        glDeleteBuffers(1, &m_buffer);
+        m_buffer = 0;
+        m_mapped = nullptr;
+    }
+}
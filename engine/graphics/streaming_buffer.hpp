@@ -0,0 +1,60 @@
+#pragma once
+
+#include <gou_engine.hpp>
+#include <glad/glad.h>
+
+namespace graphics {
+
+    /**
+     * A GPU buffer that the CPU rewrites every frame, split into three regions: while the CPU writes one, the GPU may still be
+     * reading the other two. The buffer is created with glBufferStorage and stays persistently and coherently mapped, so writes
+     * go straight to memory the GPU reads without glBufferData or glBufferSubData copies or the implicit syncs they cause.
+     * Each region is guarded by a fence, so the CPU only ever waits if it gets more than two frames ahead of the GPU.
+     * Render thread only.
+     */
+    class StreamingBuffer {
+    public:
+        static constexpr std::size_t Regions = 3;
+
+        StreamingBuffer () :
+            m_buffer(0),
+            m_mapped(nullptr),
+            m_region_size(0),
+            m_alignment(1),
+            m_region(0),
+            m_fences{}
+        {
+        }
+
+        // Allocate regions of at least 'size' bytes, rounded up to a multiple of 'alignment' so that every region starts aligned
+        void create (std::size_t size, std::size_t alignment=1);
+        void unload ();
+
+        // Make sure a region can hold 'size' bytes. If it can't, the buffer is replaced with a larger one (once the GPU has finished
+        // reading the old one) and true is returned, as any bindings of the old buffer must be redone
+        bool reserve (std::size_t size);
+
+        // Wait until the GPU has finished reading the current region and return a pointer to it
+        void* map ();
+
+        // Fence the current region, once the commands that read it have been issued, and move on to the next one
+        void advance ();
+
+        GLuint buffer () const { return m_buffer; }
+        std::size_t regionSize () const { return m_region_size; }
+        // Offset of the current region in the buffer, in bytes
+        std::size_t offset () const { return m_region * m_region_size; }
+
+    private:
+        GLuint m_buffer;
+        char* m_mapped;
+        std::size_t m_region_size;
+        std::size_t m_alignment;
+        std::size_t m_region;
+        GLsync m_fences[Regions];
+
+        void allocate (std::size_t region_size);
+        void release ();
+    };
+
+} // graphics::
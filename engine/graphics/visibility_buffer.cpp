@@ -0,0 +1,62 @@
+
+#include "visibility_buffer.hpp"
+
+void graphics::VisibilityBuffer::resize (int width, int height)
+{
+    if (width == m_width && height == m_height && m_fbo != 0) {
+        return;
+    }
+    unload();
+    m_width = std::max(width, 1);
+    m_height = std::max(height, 1);
+
+    // IDs are integers, so they are fetched exactly and never filtered
+    glGenTextures(1, &m_ids);
+    glBindTexture(GL_TEXTURE_2D, m_ids);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_RG32UI, m_width, m_height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &m_depth);
+    glBindTexture(GL_TEXTURE_2D, m_depth);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, m_width, m_height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &m_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_ids, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_depth, 0);
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        spdlog::error("Visibility buffer ({}x{}) is incomplete", m_width, m_height);
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void graphics::VisibilityBuffer::unload ()
+{
+    if (m_fbo != 0) {
+        glDeleteFramebuffers(1, &m_fbo);
+        glDeleteTextures(1, &m_ids);
+        glDeleteTextures(1, &m_depth);
+        m_fbo = m_ids = m_depth = 0;
+    }
+}
+
+void graphics::VisibilityBuffer::bind () const
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+    glViewport(0, 0, m_width, m_height);
+    const GLuint no_instance[4] = {0, 0, 0, 0};
+    glClearBufferuiv(GL_COLOR, 0, no_instance);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void graphics::VisibilityBuffer::bindTextures (GLuint ids_unit, GLuint depth_unit) const
+{
+    glActiveTexture(GL_TEXTURE0 + ids_unit);
+    glBindTexture(GL_TEXTURE_2D, m_ids);
+    glActiveTexture(GL_TEXTURE0 + depth_unit);
+    glBindTexture(GL_TEXTURE_2D, m_depth);
+}
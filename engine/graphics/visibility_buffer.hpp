@@ -0,0 +1,42 @@
+#pragma once
+
+#include <gou_engine.hpp>
+#include <glad/glad.h>
+
+namespace graphics {
+
+    /**
+     * Render target of the geometry pass of the deferred texturing renderer. Rather than shaded colors it stores, per pixel,
+     * which instance (plus one, so that 0 means nothing was drawn) and which of its triangles is visible, and the depth.
+     * A resolve pass then textures and shades each pixel exactly once from these IDs, so shading cost doesn't grow with overdraw.
+     */
+    class VisibilityBuffer {
+    public:
+        VisibilityBuffer () :
+            m_fbo(0),
+            m_ids(0),
+            m_depth(0),
+            m_width(0),
+            m_height(0)
+        {
+        }
+
+        // (Re)create the targets if the size changed
+        void resize (int width, int height);
+        void unload ();
+
+        // Bind for the geometry pass and clear it
+        void bind () const;
+
+        // Bind the ID and depth textures to texture units 'ids_unit' and 'depth_unit', for the resolve pass
+        void bindTextures (GLuint ids_unit, GLuint depth_unit) const;
+
+    private:
+        GLuint m_fbo;
+        GLuint m_ids;
+        GLuint m_depth;
+        int m_width;
+        int m_height;
+    };
+
+} // graphics::
@@ -6,6 +6,10 @@
 #include <stdexcept>
 #include <new>
 #include <atomic>
+#include <mutex>
+#include <cstring>
+#include <algorithm>
+#include <vector>
 
 namespace memory {
 
@@ -54,6 +58,17 @@ namespace memory {
                 throw std::runtime_error("StackPool allocated more items than reserved space");
             }
         }
+
+        // Allocate a contiguous block of 'count' items, but don't construct
+        T* allocate (std::uint32_t count) {
+            if (remaining() >= count) {
+                T* block = pool + next;
+                next += count;
+                return block;
+            } else {
+                throw std::runtime_error("StackPool allocated more items than reserved space");
+            }
+        }
             
         // Allocate and construct
         template <typename... Args>
@@ -125,6 +140,413 @@ namespace memory {
     };
 
 
+    /*
+     * Like StackPool, but instead of throwing when full, it grows to (at least) double its size.
+     * Growing moves the items, invalidating any pointers previously returned by allocate. The memory
+     * is kept across resets, so once the pool has grown to its high-water mark, it no longer allocates.
+     */
+    template <typename T, typename Align = NoAlign>
+    class GrowableStackPool {
+    public:
+        static_assert(std::is_trivial<T>::value, "GrowableStackPool<T> must contain a trivial type");
+        using Type = T;
+        using AlignType = Align;
+
+        GrowableStackPool (std::uint32_t size) :
+            memory(nullptr),
+            pool(nullptr),
+            next(0),
+            size(0) {
+            grow(size > 0 ? size : 1);
+        }
+        ~GrowableStackPool() {
+            delete [] memory;
+        }
+
+        // Allocate, but don't construct
+        T* allocate () {
+            reserve(next + 1);
+            return pool + next++;
+        }
+
+        // Allocate a contiguous block of 'count' items, but don't construct
+        T* allocate (std::uint32_t count) {
+            reserve(next + count);
+            T* block = pool + next;
+            next += count;
+            return block;
+        }
+
+        // Allocate and construct
+        template <typename... Args>
+        T* emplace (Args&&... args) {
+            return new(allocate()) T{args...};
+        }
+
+        void reset () {
+            next = 0;
+        }
+
+        // Make sure there is space for 'required' items in total
+        void reserve (std::uint32_t required) {
+            if (required > size) {
+                grow(std::max(required, size * 2));
+            }
+        }
+
+        std::uint32_t remaining () const {
+            return size - next;
+        }
+
+        std::uint32_t count () const {
+            return next;
+        }
+
+        std::uint32_t capacity () const {
+            return size;
+        }
+
+        T* begin () {
+            return pool;
+        }
+
+        T* end () {
+            return pool + next;
+        }
+
+        const T* cbegin () const {
+            return pool;
+        }
+
+        const T* cend () const {
+            return pool + next;
+        }
+
+        // Copy buffer into GrowableStackPool
+        void copy (const T* buffer, uint32_t count) {
+            std::memcpy(reinterpret_cast<void*>(allocate(count)), reinterpret_cast<const void*>(buffer), sizeof(T) * count);
+        }
+
+    private:
+        std::byte* memory;
+        T* pool;
+        std::uint32_t next;
+        std::uint32_t size;
+
+        void grow (std::uint32_t new_size) {
+            std::byte* new_memory = new std::byte[Align::adjust_size(sizeof(T) * new_size)];
+            T* new_pool = Align::template align<T>(new_memory);
+            if (next > 0) {
+                std::memcpy(reinterpret_cast<void*>(new_pool), reinterpret_cast<const void*>(pool), sizeof(T) * next);
+            }
+            delete [] memory;
+            memory = new_memory;
+            pool = new_pool;
+            size = new_size;
+        }
+    };
+
+
+    /*
+     * A thread-safe freelist of cache-aligned, fixed-size blocks of T, shared between ChunkedStackPools.
+     * Blocks are only ever heap allocated when the freelist is empty, so once enough blocks have been
+     * allocated to cover the workloads high-water mark, acquiring blocks no longer allocates.
+     */
+    template <typename T, std::uint32_t BlockCapacity>
+    class BlockFreeList {
+    public:
+        static_assert(std::is_trivial<T>::value, "BlockFreeList<T> must contain a trivial type");
+
+        struct alignas(64) Block {
+            T items[BlockCapacity];
+            Block* next;
+            std::uint32_t count;
+        };
+
+        BlockFreeList () :
+            free(nullptr),
+            allocated(0),
+            in_use(0),
+            high_water(0) {
+
+        }
+        ~BlockFreeList() {
+            while (free != nullptr) {
+                Block* block = free;
+                free = block->next;
+                delete block;
+            }
+        }
+
+        // Pre-allocate blocks, so that at least 'blocks' blocks exist in total
+        void reserve (std::uint32_t blocks) {
+            std::scoped_lock<std::mutex> lock(mutex);
+            while (allocated < blocks) {
+                Block* block = new Block;
+                block->next = free;
+                free = block;
+                ++allocated;
+            }
+        }
+
+        // Take a block from the freelist, allocating a new one only if the freelist is empty
+        Block* acquire () {
+            std::scoped_lock<std::mutex> lock(mutex);
+            Block* block;
+            if (free != nullptr) {
+                block = free;
+                free = block->next;
+            } else {
+                block = new Block;
+                ++allocated;
+            }
+            if (++in_use > high_water) {
+                high_water = in_use;
+            }
+            block->next = nullptr;
+            block->count = 0;
+            return block;
+        }
+
+        // Return a linked chain of blocks to the freelist
+        void release (Block* first) {
+            if (first == nullptr) {
+                return;
+            }
+            std::uint32_t released = 1;
+            Block* last = first;
+            while (last->next != nullptr) {
+                last = last->next;
+                ++released;
+            }
+            std::scoped_lock<std::mutex> lock(mutex);
+            last->next = free;
+            free = first;
+            in_use -= released;
+        }
+
+        // Total number of blocks that have been heap allocated
+        std::uint32_t count () const {
+            std::scoped_lock<std::mutex> lock(mutex);
+            return allocated;
+        }
+
+        // Maximum number of blocks that were simultaneously in use
+        std::uint32_t highWaterMark () const {
+            std::scoped_lock<std::mutex> lock(mutex);
+            return high_water;
+        }
+
+    private:
+        mutable std::mutex mutex;
+        Block* free;
+        std::uint32_t allocated;
+        std::uint32_t in_use;
+        std::uint32_t high_water;
+    };
+
+
+    /*
+     * A stack pool made of a linked chain of blocks taken from a shared BlockFreeList.
+     * Never runs out of space: when the current block is full, another one is linked in.
+     * Pointers returned by allocate remain valid until reset. Not thread-safe (meant to be used thread-locally).
+     */
+    template <typename T, std::uint32_t BlockCapacity = 64>
+    class ChunkedStackPool {
+    public:
+        static_assert(std::is_trivial<T>::value, "ChunkedStackPool<T> must contain a trivial type");
+        using Type = T;
+        using FreeList = BlockFreeList<T, BlockCapacity>;
+        using Block = typename FreeList::Block;
+
+        ChunkedStackPool (FreeList& freelist) :
+            freelist(freelist),
+            head(freelist.acquire()),
+            tail(head),
+            next(0),
+            high_water(0) {
+
+        }
+        ~ChunkedStackPool() {
+            freelist.release(head);
+        }
+
+        // Allocate, but don't construct
+        T* allocate () {
+            if (tail->count == BlockCapacity) {
+                tail->next = freelist.acquire();
+                tail = tail->next;
+            }
+            ++next;
+            return tail->items + tail->count++;
+        }
+
+        // Allocate and construct
+        template <typename... Args>
+        T* emplace (Args&&... args) {
+            return new(allocate()) T{args...};
+        }
+
+        // Hand over all blocks to the caller and continue with a fresh block. The caller must return the blocks with FreeList::release
+        Block* handover () {
+            if (next > high_water) {
+                high_water = next;
+            }
+            Block* blocks = head;
+            head = freelist.acquire();
+            tail = head;
+            next = 0;
+            return blocks;
+        }
+
+        // Return all but the first block to the freelist, so that pools which rarely need more than one block never touch the freelist
+        void reset () {
+            if (next > high_water) {
+                high_water = next;
+            }
+            freelist.release(head->next);
+            head->next = nullptr;
+            head->count = 0;
+            tail = head;
+            next = 0;
+        }
+
+        std::uint32_t count () const {
+            return next;
+        }
+
+        // Maximum number of items that were allocated between resets
+        std::uint32_t highWaterMark () const {
+            return high_water;
+        }
+
+        // Call fn(const T* items, std::uint32_t count) for each non-empty block, in allocation order
+        template <typename Fn>
+        void each_block (Fn fn) const {
+            each_block(head, fn);
+        }
+
+        // Call fn(const T* items, std::uint32_t count) for each non-empty block in a chain (eg one returned by handover)
+        template <typename Fn>
+        static void each_block (const Block* first, Fn fn) {
+            for (const Block* block = first; block != nullptr; block = block->next) {
+                if (block->count > 0) {
+                    fn(block->items, block->count);
+                }
+            }
+        }
+
+    private:
+        FreeList& freelist;
+        Block* head;
+        Block* tail;
+        std::uint32_t next;
+        std::uint32_t high_water;
+    };
+
+
+    /*
+     * A double-buffered arena for variable-sized, trivially-copyable data, recycled in bulk.
+     * Allocations made since the last swap are in the 'write' generation. On swap, they become the 'read'
+     * generation and stay valid until the next swap, at which point their blocks are recycled. Allocations are
+     * identified by a Location (block index and offset, in units of Alignment), so they can be referred to compactly.
+     * Allocations larger than a block get their own oversized block, which is freed rather than recycled.
+     * Not thread-safe (meant to be used thread-locally).
+     */
+    template <std::uint32_t BlockSize = 65536, std::uint32_t Alignment = 16>
+    class FrameArena {
+    public:
+        static_assert(Alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "FrameArena alignment must not exceed the default new alignment");
+        static_assert(BlockSize % Alignment == 0, "FrameArena block size must be a multiple of its alignment");
+
+        struct Location {
+            std::uint32_t block;
+            std::uint32_t offset;
+        };
+
+        FrameArena () :
+            write(0),
+            current(NoBlock),
+            used(0) {
+
+        }
+        ~FrameArena() {
+            for (auto& generation : generations) {
+                for (auto& block : generation) {
+                    delete [] block.memory;
+                }
+            }
+            for (auto memory : spare) {
+                delete [] memory;
+            }
+        }
+
+        // Allocate 'size' bytes in the write generation
+        std::byte* allocate (std::size_t size, Location& location) {
+            const std::size_t aligned_size = (size + Alignment - 1) & ~std::size_t(Alignment - 1);
+            auto& blocks = generations[write];
+            if (aligned_size > BlockSize) {
+                blocks.push_back({new std::byte[aligned_size], aligned_size});
+                location = {std::uint32_t(blocks.size() - 1), 0};
+                return blocks.back().memory;
+            }
+            if (current == NoBlock || used + aligned_size > BlockSize) {
+                std::byte* memory;
+                if (! spare.empty()) {
+                    memory = spare.back();
+                    spare.pop_back();
+                } else {
+                    memory = new std::byte[BlockSize];
+                }
+                blocks.push_back({memory, BlockSize});
+                current = std::uint32_t(blocks.size() - 1);
+                used = 0;
+            }
+            location = {current, std::uint32_t(used / Alignment)};
+            std::byte* memory = blocks[current].memory + used;
+            used += aligned_size;
+            return memory;
+        }
+
+        // Access an allocation in the read generation
+        const std::byte* get (Location location) const {
+            const auto& blocks = generations[1 - write];
+            if (location.block < blocks.size()) {
+                return blocks[location.block].memory + (location.offset * Alignment);
+            }
+            return nullptr;
+        }
+
+        // Make the write generation readable and recycle the previous read generation
+        void swap () {
+            auto& blocks = generations[1 - write];
+            for (auto& block : blocks) {
+                if (block.size == BlockSize) {
+                    spare.push_back(block.memory);
+                } else {
+                    delete [] block.memory;
+                }
+            }
+            blocks.clear();
+            write = 1 - write;
+            current = NoBlock;
+            used = 0;
+        }
+
+    private:
+        static constexpr std::uint32_t NoBlock = ~std::uint32_t(0);
+        struct Block {
+            std::byte* memory;
+            std::size_t size;
+        };
+        std::vector<Block> generations[2];
+        std::vector<std::byte*> spare;
+        std::uint32_t write;
+        std::uint32_t current;
+        std::size_t used;
+    };
+
+
     template <typename T, typename Align = NoAlign>
     class AtomicStackPool {
     public:
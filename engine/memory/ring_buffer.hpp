@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+
+namespace memory {
+
+    /**
+     * Lock-free single-producer, single-consumer ring buffer of fixed capacity.
+     * The producer never blocks: if the consumer has fallen behind and the ring is full, push() fails and the item is dropped.
+     */
+    template <typename T, std::uint32_t Capacity>
+    class SPSCRingBuffer {
+    public:
+        static_assert((Capacity & (Capacity - 1)) == 0, "SPSCRingBuffer capacity must be a power of two");
+        static_assert(std::is_trivially_copyable<T>::value, "SPSCRingBuffer<T> must contain a trivially copyable type");
+        using Type = T;
+
+        // Producer only: add an item, returns false if the ring is full
+        bool push (const T& item) {
+            const std::uint32_t current = head.load(std::memory_order_relaxed);
+            if (current - tail.load(std::memory_order_acquire) == Capacity) {
+                return false;
+            }
+            items[current & Mask] = item;
+            head.store(current + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only: call fn(const T&) for every item in the ring, removing them
+        template <typename Fn>
+        void consume (Fn fn) {
+            std::uint32_t current = tail.load(std::memory_order_relaxed);
+            const std::uint32_t last = head.load(std::memory_order_acquire);
+            while (current != last) {
+                fn(items[current & Mask]);
+                ++current;
+            }
+            tail.store(current, std::memory_order_release);
+        }
+
+    private:
+        static constexpr std::uint32_t Mask = Capacity - 1;
+        // Head and tail are on separate cache lines, so that the producer and consumer don't false-share
+        alignas(64) std::atomic<std::uint32_t> head{0};
+        alignas(64) std::atomic<std::uint32_t> tail{0};
+        alignas(64) T items[Capacity];
+    };
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace memory {
+
+    /**
+     * Lock-free triple buffer, for handing the latest version of a value from one producer thread to one consumer thread.
+     * The producer writes into the back slot and publishes it, the consumer reads from the front slot and swaps it for the
+     * most recently published slot when it wants newer data. Neither side ever waits for the other: if the producer publishes
+     * faster than the consumer reads, older versions are overwritten and the consumer only ever sees the newest one.
+     * Slots are reused, so values should be cleared and refilled rather than reconstructed, to keep their allocations.
+     */
+    template <typename T>
+    class TripleBuffer {
+    public:
+        using Type = T;
+
+        // Producer only: the slot to fill with the next version
+        T& back () { return slots[back_index]; }
+
+        // Producer only: make the back slot the newest version, the producer gets the previous unread (or already read) slot back
+        void publish () {
+            back_index = ready.exchange(back_index | Fresh, std::memory_order_acq_rel) & IndexMask;
+        }
+
+        // Either side: true if a version was published that the consumer hasn't switched to yet
+        bool pending () const {
+            return (ready.load(std::memory_order_acquire) & Fresh) != 0;
+        }
+
+        // Consumer only: switch the front slot to the newest version, returns false if there was nothing newer
+        bool update () {
+            if (! pending()) {
+                return false;
+            }
+            front_index = ready.exchange(front_index, std::memory_order_acq_rel) & IndexMask;
+            return true;
+        }
+
+        // Consumer only: the version being read
+        const T& front () const { return slots[front_index]; }
+
+    private:
+        static constexpr std::uint32_t IndexMask = 3;
+        static constexpr std::uint32_t Fresh = 4;
+        T slots[3];
+        std::uint32_t back_index = 0;
+        std::uint32_t front_index = 1;
+        // Index of the slot that is neither front nor back, flagged as Fresh if it holds a version the consumer hasn't seen
+        alignas(64) std::atomic<std::uint32_t> ready{2};
+    };
+
+}
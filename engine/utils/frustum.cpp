@@ -0,0 +1,82 @@
+
+#include "frustum.hpp"
+
+#include "simd.hpp"
+
+#include <cstring>
+
+math::Frustum math::frustum (const glm::mat4& projection_view)
+{
+    // Rows of the matrix, glm is column major
+    const glm::mat4 m = glm::transpose(projection_view);
+    Frustum frustum{{m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[3] + m[2], m[3] - m[2]}};
+    for (auto& plane : frustum.planes) {
+        plane /= glm::length(glm::vec3(plane));
+    }
+    return frustum;
+}
+
+std::size_t math::cullSpheres (const Frustum& frustum, const SphereStreams& input, std::size_t begin, std::size_t end, std::uint32_t* visible)
+{
+    std::size_t count = 0;
+    std::size_t index = begin;
+#ifdef SIMD_LANES
+    using L = simd::Lanes;
+    L::F planes[6][4];
+    for (std::size_t plane = 0; plane < 6; ++plane) {
+        for (glm::length_t element = 0; element < 4; ++element) {
+            planes[plane][element] = L::set(frustum.planes[plane][element]);
+        }
+    }
+    const L::F sign_bit = L::set(-0.0f);
+    for (; index + L::Width <= end; index += L::Width) {
+        const L::F x = L::load(input.center[0] + index);
+        const L::F y = L::load(input.center[1] + index);
+        const L::F z = L::load(input.center[2] + index);
+        const L::F negative_radius = L::bitXor(L::load(input.radius + index), sign_bit);
+        // A sphere is outside if its center is further than its radius behind any one plane
+        L::F outside = L::set(0.0f);
+        for (const auto& plane : planes) {
+            const L::F distance = L::fma(plane[0], x, L::fma(plane[1], y, L::fma(plane[2], z, plane[3])));
+            outside = L::bitOr(outside, L::less(distance, negative_radius));
+        }
+        // Write every lanes index, but only advance past the visible ones
+        const unsigned inside = ~L::mask(outside);
+        for (std::size_t lane = 0; lane < L::Width; ++lane) {
+            visible[count] = std::uint32_t(index + lane);
+            count += (inside >> lane) & 1;
+        }
+    }
+#endif
+    for (; index < end; ++index) {
+        const glm::vec3 center{input.center[0][index], input.center[1][index], input.center[2][index]};
+        bool inside = true;
+        for (const auto& plane : frustum.planes) {
+            inside &= glm::dot(glm::vec3(plane), center) + plane.w >= -input.radius[index];
+        }
+        visible[count] = std::uint32_t(index);
+        count += inside ? 1 : 0;
+    }
+    return count;
+}
+
+tf::Task math::cullSpheres (tf::FlowBuilder& flow, const Frustum& frustum, const SphereStreams& input, std::size_t count, std::vector<std::uint32_t>& visible, std::vector<std::size_t>& chunk_counts, std::size_t chunk_size)
+{
+    return flow.emplace([frustum, input, count, &visible, &chunk_counts, chunk_size](tf::Subflow& subflow){
+        const std::size_t chunks = (count + chunk_size - 1) / chunk_size;
+        visible.resize(count);
+        chunk_counts.resize(chunks);
+        subflow.for_each_index(std::size_t{0}, chunks, std::size_t{1}, [&frustum, &input, &visible, &chunk_counts, count, chunk_size](std::size_t chunk){
+            const std::size_t begin = chunk * chunk_size;
+            chunk_counts[chunk] = cullSpheres(frustum, input, begin, std::min(begin + chunk_size, count), visible.data() + begin);
+        });
+        subflow.join();
+        // Close the gaps left by culled spheres between the slices
+        std::size_t visible_count = chunks > 0 ? chunk_counts[0] : 0;
+        for (std::size_t chunk = 1; chunk < chunks; ++chunk) {
+            std::memmove(visible.data() + visible_count, visible.data() + chunk * chunk_size, chunk_counts[chunk] * sizeof(std::uint32_t));
+            visible_count += chunk_counts[chunk];
+        }
+        visible.resize(visible_count);
+    }).name("Frustum culling");
+}
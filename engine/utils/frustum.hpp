@@ -0,0 +1,37 @@
+#pragma once
+
+#include "gou_engine.hpp"
+
+#include <taskflow/taskflow.hpp>
+
+namespace math {
+
+    // The six planes of a view frustum (left, right, bottom, top, near, far), with normalised normals pointing inwards: xyz is the normal, w the distance
+    struct Frustum {
+        glm::vec4 planes[6];
+    };
+
+    // Extract the frustum planes from a projection * view matrix (Gribb & Hartmann), in world space
+    Frustum frustum (const glm::mat4& projection_view);
+
+    // Bounding spheres, as a structure of arrays
+    struct SphereStreams {
+        const float* center[3];
+        const float* radius;
+    };
+
+    /**
+     * Test the spheres in [begin, end) against the frustum, writing the indices of the spheres that are at least partially inside
+     * it to 'visible' (in order, starting at visible[0]) and returning how many were written.
+     * Uses AVX2 (8 at a time) or SSE4.1 (4 at a time) if the build enables them, with a scalar fallback for the remainder.
+     */
+    std::size_t cullSpheres (const Frustum& frustum, const SphereStreams& input, std::size_t begin, std::size_t end, std::uint32_t* visible);
+
+    /**
+     * Add a task to 'flow' which tests 'count' spheres in parallel chunks across the executors workers and leaves the indices of the visible
+     * ones in 'visible', in order. Each chunk writes to its own slice of 'visible', the slices are then compacted. 'visible' and 'chunk_counts'
+     * are only scratch space until the task has run, they must stay alive until then.
+     */
+    tf::Task cullSpheres (tf::FlowBuilder& flow, const Frustum& frustum, const SphereStreams& input, std::size_t count, std::vector<std::uint32_t>& visible, std::vector<std::size_t>& chunk_counts, std::size_t chunk_size = 4096);
+
+} // math::
@@ -0,0 +1,74 @@
+#pragma once
+
+/**
+ * Thin wrappers over the intrinsics of the widest instruction set the build enables (AVX2 or SSE4.1), so that
+ * batch kernels can be written once. SIMD_LANES is defined if either is available, otherwise kernels should fall back
+ * to scalar code.
+ */
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#define SIMD_LANES
+#include <immintrin.h>
+#include <cstddef>
+
+namespace simd {
+
+#if defined(__AVX2__)
+    struct Lanes {
+        using F = __m256;
+        static constexpr std::size_t Width = 8;
+        static F load (const float* p) { return _mm256_loadu_ps(p); }
+        static void store (float* p, F v) { _mm256_store_ps(p, v); }
+        static F set (float v) { return _mm256_set1_ps(v); }
+        static F add (F a, F b) { return _mm256_add_ps(a, b); }
+        static F sub (F a, F b) { return _mm256_sub_ps(a, b); }
+        static F mul (F a, F b) { return _mm256_mul_ps(a, b); }
+#if defined(__FMA__)
+        static F fma (F a, F b, F c) { return _mm256_fmadd_ps(a, b, c); }
+#else
+        static F fma (F a, F b, F c) { return _mm256_add_ps(_mm256_mul_ps(a, b), c); }
+#endif
+        static F sqrt (F v) { return _mm256_sqrt_ps(v); }
+        static F round (F v) { return _mm256_round_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static F bitAnd (F a, F b) { return _mm256_and_ps(a, b); }
+        static F bitAndNot (F a, F b) { return _mm256_andnot_ps(a, b); }
+        static F bitOr (F a, F b) { return _mm256_or_ps(a, b); }
+        static F bitXor (F a, F b) { return _mm256_xor_ps(a, b); }
+        static F greater (F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static F less (F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        static F select (F mask, F a, F b) { return _mm256_blendv_ps(b, a, mask); }
+        // One bit per lane, set if the lanes mask is set
+        static unsigned mask (F v) { return unsigned(_mm256_movemask_ps(v)); }
+    };
+#else
+    struct Lanes {
+        using F = __m128;
+        static constexpr std::size_t Width = 4;
+        static F load (const float* p) { return _mm_loadu_ps(p); }
+        static void store (float* p, F v) { _mm_store_ps(p, v); }
+        static F set (float v) { return _mm_set1_ps(v); }
+        static F add (F a, F b) { return _mm_add_ps(a, b); }
+        static F sub (F a, F b) { return _mm_sub_ps(a, b); }
+        static F mul (F a, F b) { return _mm_mul_ps(a, b); }
+#if defined(__FMA__)
+        static F fma (F a, F b, F c) { return _mm_fmadd_ps(a, b, c); }
+#else
+        static F fma (F a, F b, F c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+#endif
+        static F sqrt (F v) { return _mm_sqrt_ps(v); }
+        static F round (F v) { return _mm_round_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+        static F bitAnd (F a, F b) { return _mm_and_ps(a, b); }
+        static F bitAndNot (F a, F b) { return _mm_andnot_ps(a, b); }
+        static F bitOr (F a, F b) { return _mm_or_ps(a, b); }
+        static F bitXor (F a, F b) { return _mm_xor_ps(a, b); }
+        static F greater (F a, F b) { return _mm_cmpgt_ps(a, b); }
+        static F less (F a, F b) { return _mm_cmplt_ps(a, b); }
+        static F select (F mask, F a, F b) { return _mm_blendv_ps(b, a, mask); }
+        // One bit per lane, set if the lanes mask is set
+        static unsigned mask (F v) { return unsigned(_mm_movemask_ps(v)); }
+    };
+#endif
+
+} // simd::
+
+#endif
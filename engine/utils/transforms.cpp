@@ -0,0 +1,125 @@
+
+#include "transforms.hpp"
+
+#include "simd.hpp"
+
+#include <cmath>
+
+namespace {
+
+    constexpr float FullCircle = 6.28318530717958647692f;
+
+    // Rows of the matrix for a single transform
+    void computeTransform (const math::TransformStreams& input, std::size_t index, math::Matrix4x3& output)
+    {
+        const float sin_a = std::sin(input.rotation[0][index] * FullCircle);
+        const float cos_a = std::cos(input.rotation[0][index] * FullCircle);
+        const float sin_b = std::sin(input.rotation[1][index] * FullCircle);
+        const float cos_b = std::cos(input.rotation[1][index] * FullCircle);
+        const float sin_c = std::sin(input.rotation[2][index] * FullCircle);
+        const float cos_c = std::cos(input.rotation[2][index] * FullCircle);
+        const float sx = input.scale[0][index];
+        const float sy = input.scale[1][index];
+        const float sz = input.scale[2][index];
+        output.rows[0] = {cos_b * cos_c * sx, -cos_b * sin_c * sy, sin_b * sz, input.position[0][index]};
+        output.rows[1] = {(cos_a * sin_c + sin_a * sin_b * cos_c) * sx, (cos_a * cos_c - sin_a * sin_b * sin_c) * sy, -sin_a * cos_b * sz, input.position[1][index]};
+        output.rows[2] = {(sin_a * sin_c - cos_a * sin_b * cos_c) * sx, (sin_a * cos_c + cos_a * sin_b * sin_c) * sy, cos_a * cos_b * sz, input.position[2][index]};
+    }
+
+#ifdef SIMD_LANES
+
+    using L = simd::Lanes;
+    using F = L::F;
+
+    // Sine and cosine of angles in turns: wrap to half a turn either side of zero, reflect into a quarter turn either side and evaluate polynomials there
+    void sincos (F turns, F& sin_out, F& cos_out)
+    {
+        const F sign_bit = L::set(-0.0f);
+        F u = L::sub(turns, L::round(turns));
+        const F sign = L::bitAnd(u, sign_bit);
+        const F magnitude = L::bitAndNot(sign_bit, u);
+        // sin(half - u) = sin(u), cos(half - u) = -cos(u)
+        const F reflect = L::greater(magnitude, L::set(0.25f));
+        u = L::select(reflect, L::bitXor(L::sub(L::set(0.5f), magnitude), sign), u);
+        const F cos_sign = L::bitAnd(reflect, sign_bit);
+
+        const F x = L::mul(u, L::set(FullCircle));
+        const F x2 = L::mul(x, x);
+        F s = L::set(1.0f / 362880.0f);
+        s = L::fma(s, x2, L::set(-1.0f / 5040.0f));
+        s = L::fma(s, x2, L::set(1.0f / 120.0f));
+        s = L::fma(s, x2, L::set(-1.0f / 6.0f));
+        s = L::fma(s, x2, L::set(1.0f));
+        sin_out = L::mul(s, x);
+        F c = L::set(-1.0f / 3628800.0f);
+        c = L::fma(c, x2, L::set(1.0f / 40320.0f));
+        c = L::fma(c, x2, L::set(-1.0f / 720.0f));
+        c = L::fma(c, x2, L::set(1.0f / 24.0f));
+        c = L::fma(c, x2, L::set(-0.5f));
+        c = L::fma(c, x2, L::set(1.0f));
+        cos_out = L::bitXor(c, cos_sign);
+    }
+
+    // Compute L::Width transforms starting at index
+    void computeTransformLanes (const math::TransformStreams& input, std::size_t index, math::Matrix4x3* output)
+    {
+        F sin_a, cos_a, sin_b, cos_b, sin_c, cos_c;
+        sincos(L::load(input.rotation[0] + index), sin_a, cos_a);
+        sincos(L::load(input.rotation[1] + index), sin_b, cos_b);
+        sincos(L::load(input.rotation[2] + index), sin_c, cos_c);
+        const F sx = L::load(input.scale[0] + index);
+        const F sy = L::load(input.scale[1] + index);
+        const F sz = L::load(input.scale[2] + index);
+        const F sin_a_sin_b = L::mul(sin_a, sin_b);
+        const F cos_a_sin_b = L::mul(cos_a, sin_b);
+        const F negative = L::set(-0.0f);
+
+        // The twelve matrix elements of each lane, row by row
+        alignas(32) float elements[12][L::Width];
+        L::store(elements[0], L::mul(L::mul(cos_b, cos_c), sx));
+        L::store(elements[1], L::bitXor(L::mul(L::mul(cos_b, sin_c), sy), negative));
+        L::store(elements[2], L::mul(sin_b, sz));
+        L::store(elements[3], L::load(input.position[0] + index));
+        L::store(elements[4], L::mul(L::fma(sin_a_sin_b, cos_c, L::mul(cos_a, sin_c)), sx));
+        L::store(elements[5], L::mul(L::sub(L::mul(cos_a, cos_c), L::mul(sin_a_sin_b, sin_c)), sy));
+        L::store(elements[6], L::bitXor(L::mul(L::mul(sin_a, cos_b), sz), negative));
+        L::store(elements[7], L::load(input.position[1] + index));
+        L::store(elements[8], L::mul(L::sub(L::mul(sin_a, sin_c), L::mul(cos_a_sin_b, cos_c)), sx));
+        L::store(elements[9], L::mul(L::fma(cos_a_sin_b, sin_c, L::mul(sin_a, cos_c)), sy));
+        L::store(elements[10], L::mul(L::mul(cos_a, cos_b), sz));
+        L::store(elements[11], L::load(input.position[2] + index));
+
+        // Interleave the lanes into packed matrices
+        for (std::size_t lane = 0; lane < L::Width; ++lane) {
+            float* matrix = &output[index + lane].rows[0].x;
+            for (std::size_t element = 0; element < 12; ++element) {
+                matrix[element] = elements[element][lane];
+            }
+        }
+    }
+
+#endif
+
+}
+
+void math::computeTransforms (const TransformStreams& input, std::size_t begin, std::size_t end, Matrix4x3* output)
+{
+    std::size_t index = begin;
+#ifdef SIMD_LANES
+    for (; index + L::Width <= end; index += L::Width) {
+        computeTransformLanes(input, index, output);
+    }
+#endif
+    for (; index < end; ++index) {
+        computeTransform(input, index, output[index]);
+    }
+}
+
+tf::Task math::computeTransforms (tf::FlowBuilder& flow, const TransformStreams& input, std::size_t count, Matrix4x3* output, std::size_t chunk_size)
+{
+    const std::size_t chunks = (count + chunk_size - 1) / chunk_size;
+    return flow.for_each_index(std::size_t{0}, chunks, std::size_t{1}, [input, count, output, chunk_size](std::size_t chunk){
+        const std::size_t begin = chunk * chunk_size;
+        computeTransforms(input, begin, std::min(begin + chunk_size, count), output);
+    }).name("Transforms");
+}
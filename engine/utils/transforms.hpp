@@ -0,0 +1,31 @@
+#pragma once
+
+#include "gou_engine.hpp"
+
+#include <taskflow/taskflow.hpp>
+
+namespace math {
+
+    // Affine model matrix, stored as the top three rows of a 4x4 matrix (the fourth row is always 0, 0, 0, 1)
+    struct Matrix4x3 {
+        glm::vec4 rows[3];
+    };
+
+    // Transform inputs, as a structure of arrays: one array per component of each vector
+    struct TransformStreams {
+        const float* position[3];
+        const float* rotation[3]; // Euler angles in turns, applied around x, then y, then z
+        const float* scale[3];
+    };
+
+    /**
+     * Compute translate * rotateX * rotateY * rotateZ * scale for the transforms in [begin, end), writing the matrices to output[begin, end).
+     * Uses AVX2 (8 at a time) or SSE4.1 (4 at a time) if the build enables them, with polynomial sine and cosine accurate to about 1e-5,
+     * and a scalar fallback for the remainder or when neither is available.
+     */
+    void computeTransforms (const TransformStreams& input, std::size_t begin, std::size_t end, Matrix4x3* output);
+
+    // Add a task to 'flow' which computes 'count' transforms in parallel chunks across the executors workers
+    tf::Task computeTransforms (tf::FlowBuilder& flow, const TransformStreams& input, std::size_t count, Matrix4x3* output, std::size_t chunk_size = 4096);
+
+} // math::
@@ -75,6 +75,9 @@ void world::SceneManager::loadScene (entt::hashed_string scene)
                     auto entity_id = prototype_registry.create();
                     prototype_registry.emplace<core::EntityPrototypeID>(entity_id, entt::hashed_string::value(name.c_str()));
                     for (const auto& [name_str, component]  : entity.as_table()) {
+                        if (name_str == "_name_") {
+                            continue;
+                        }
                         SPDLOG_TRACE("[SceneManager] Adding component to prototype entity {}: {}", name, name_str);
                         toml::value value = component;
                         m_engine.loadComponent(core::Engine::EntityLoadType::LoadToPrototype, entt::hashed_string{name_str.c_str()}, entity_id, reinterpret_cast<const void*>(&value));
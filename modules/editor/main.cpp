@@ -142,6 +142,7 @@ public:
         if (m_scene_panel.selected() != entt::null && m_properties_panel.selected() == entt::null) {
             m_scene_panel.deselect();
         }
+        m_stats_panel.beforeRender(engine);
     }
 
     void onAfterRender (gou::Renderer& renderer)
@@ -252,7 +253,7 @@ public:
         m_gameplan_panel.renderPanel();
         m_assets_panel.renderPanel();
         m_global_settings_panel.renderPanel();
-        m_stats_panel.renderPanel();
+        m_stats_panel.renderPanel(renderer);
 
 #ifdef DEBUG_BUILD
         if (m_show_curve_editor) {
@@ -1,7 +1,15 @@
 
 #include "stats.hpp"
 
-void StatsPanel::render ()
+void StatsPanel::beforeRender (gou::Engine& engine)
+{
+    if (visible()) {
+        // Copy the stats while holding the engine lock, render() runs without it
+        m_system_stats = engine.systemStats();
+    }
+}
+
+void StatsPanel::render (gou::Renderer& renderer)
 {
     // auto stats = Renderer2D::GetStats();
     // ImGui::Text("Renderer2D Stats:");
@@ -13,4 +21,38 @@ void StatsPanel::render ()
     ImGui::Text("Current time: %.1f", current_time);
     ImGui::Text("Frame time: %.2f ms", 1000.0f / ImGui::GetIO().Framerate);
     ImGui::Text("Framerate: %.1f FPS", ImGui::GetIO().Framerate);
+
+    if (ImGui::CollapsingHeader("Rendering", ImGuiTreeNodeFlags_DefaultOpen)) {
+        const auto& render_stats = renderer.renderStats();
+        ImGui::Text("Sprites tested: %u", render_stats.sprites_tested);
+        ImGui::Text("Sprites culled: %u", render_stats.sprites_culled);
+        ImGui::Text("Sprites drawn: %u", render_stats.sprites_tested - render_stats.sprites_culled);
+        ImGui::Text("Draw calls: %u", render_stats.draw_calls);
+        ImGui::Text("State changes: %u", render_stats.state_changes);
+    }
+
+    if (! m_system_stats.empty() && ImGui::CollapsingHeader("Systems", ImGuiTreeNodeFlags_DefaultOpen)) {
+        if (ImGui::BeginTable("System Stats", 7, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            ImGui::TableSetupColumn("System", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("Worker");
+            ImGui::TableSetupColumn("Last");
+            ImGui::TableSetupColumn("Mean");
+            ImGui::TableSetupColumn("p95");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableSetupColumn("Max");
+            ImGui::TableHeadersRow();
+            for (const auto& stats : m_system_stats) {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(stats.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%d", stats.worker);
+                for (float value : {stats.last, stats.mean, stats.p95, stats.p99, stats.max}) {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%.3f ms", value);
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
 }
@@ -7,8 +7,12 @@ public:
     StatsPanel () : Panel<StatsPanel>("Stats", ImGuiWindowFlags_None, false) {}
     ~StatsPanel() {}
 
-    void render ();
+    void beforeRender (gou::Engine& engine);
+    void render (gou::Renderer& renderer);
 
     std::uint64_t current_frame;
     Time current_time;
+
+private:
+    std::vector<gou::api::SystemStats> m_system_stats;
 };
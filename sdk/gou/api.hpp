@@ -1,8 +1,10 @@
 #pragma once
 
+#include <algorithm>
 #include <cstdint>
 #include <string>
 #include <variant>
+#include <type_traits>
 
 #include <entt/core/hashed_string.hpp>
 #include <entt/entity/registry.hpp>
@@ -32,10 +34,61 @@ namespace gou::api {
             Module* mod;
         };
 
+        // Read-only view of events, stored as a list of contiguous segments (the blocks handed over by each threads event pool)
         struct EventsIterator {
             using Type = gou::events::Event;
-            Type* data;
+            struct Segment {
+                const Type* data;
+                std::uint32_t count;
+            };
+            const Segment* segments;
+            std::size_t num_segments;
             std::size_t count;
+
+            class iterator {
+            public:
+                iterator (const Segment* segment, std::uint32_t index) : segment(segment), index(index) {}
+                const Type& operator* () const { return segment->data[index]; }
+                const Type* operator-> () const { return segment->data + index; }
+                iterator& operator++ () {
+                    if (++index == segment->count) {
+                        ++segment;
+                        index = 0;
+                    }
+                    return *this;
+                }
+                bool operator== (const iterator& other) const { return segment == other.segment && index == other.index; }
+                bool operator!= (const iterator& other) const { return !(*this == other); }
+            private:
+                const Segment* segment;
+                std::uint32_t index;
+            };
+
+            // Segments are never empty, so iteration can step straight from the end of one segment to the start of the next
+            iterator begin () const { return {segments, 0}; }
+            iterator end () const { return {segments + num_segments, 0}; }
+        };
+
+        // Read-only view of the events of a single type, as an array of pointers into the events segments
+        struct EventChannelIterator {
+            using Type = gou::events::Event;
+            const Type* const* data;
+            std::size_t count;
+
+            class iterator {
+            public:
+                iterator (const Type* const* it) : it(it) {}
+                const Type& operator* () const { return **it; }
+                const Type* operator-> () const { return *it; }
+                iterator& operator++ () { ++it; return *this; }
+                bool operator== (const iterator& other) const { return it == other.it; }
+                bool operator!= (const iterator& other) const { return it != other.it; }
+            private:
+                const Type* const* it;
+            };
+
+            iterator begin () const { return {data}; }
+            iterator end () const { return {data + count}; }
         };
     }
 
@@ -57,12 +110,38 @@ namespace gou::api {
         Prototype,
     };
 
+    // Rolling timing statistics of a system, all times are in milliseconds
+    struct SystemStats {
+        std::string name;
+        SystemStage stage;
+        std::int32_t worker;    // Worker thread the system last ran on
+        float start;            // When the system last started, relative to the start of the frames systems
+        float last;             // Duration of the last run
+        // Over the most recent runs (up to SystemStats::Window)
+        float mean;
+        float p95;
+        float p99;
+        float max;
+        static constexpr std::uint32_t Window = 128;
+    };
+
+    // Counters of the most recently rendered frame
+    struct RenderStats {
+        std::uint32_t sprites_tested;   // Sprites tested against the view frustum
+        std::uint32_t sprites_culled;   // Sprites outside of the view frustum, which were not drawn
+        std::uint32_t state_changes;    // Shader, material and texture binds
+        std::uint32_t draw_calls;
+    };
+
     class Renderer {
     public:
         virtual ~Renderer() {}
         virtual void setViewport (const glm::vec4&) = 0;
 
         virtual bool hasImGui () const = 0;
+
+        // Only valid in the 'renderer' context (onBeforeRender and onAfterRender)
+        virtual const RenderStats& renderStats () const = 0;
     };
 
     // The module-provided API to the engine
@@ -87,21 +166,39 @@ namespace gou::api {
              * the data is atomic or protected by a lock, however locks should be avoided to maintain high performance.
              * 
              * Hooks that execute in the 'engine' context are:
-             *  onLoad, onUnload, onBeforeReload, onAfterReload, onBeforeFrame, onBeforeUpdate, onAfterFrame, onLoadScene, onUnloadScene and onPrepareRender
+             *  onLoad, onUnload, onBeforeReload, onAfterReload, onRegisterSystems, onBeforeFrame, onBeforeUpdate, onAfterFrame, onLoadScene, onUnloadScene and onPrepareRender
              * 
              * Hooks that execute in the 'renderer' context are:
              *  onBeforeRender, onAfterRender and onPrepareRender
              * 
              * It is safe to access both engine and render data from onPrepareRender (technically it runs in the 'renderer' context, but inside a critical
              * section, allowing safe access to the engine -- however, logic in onPrepareRender should be kept to a minimum).
+             * The engine only waits for the renderer when a module has an onPrepareRender hook, otherwise simulation and rendering overlap, so only
+             * implement it when a module really needs engine data on the render thread (eg the editor).
              * 
              * Systems execute in the 'engine' context, however, it is not safe to access the engine from inside a system as they may be scheduled in parallel.
              * Instead, systems should communicate either through their writeable components on the entities they process, or by setting local member data in
              * their Module, that you know isn't being accessed by another system and then using a hook (eg onBeforeUpdate or onAfterFrame) to communicate the
              * data elsewhere.
              * 
-             * It is safe to emit events at any time from the 'engine' context, even in systems. The 'render' context (excluding onPrepareRender) should not
-             * emit events.
+             * It is safe to emit events at any time from the 'engine' context, even in systems, and from the 'render' context hooks. Events emitted from
+             * onBeforeRender and onAfterRender become readable once the engine next pumps events while the renderer isn't inside those hooks, which may
+             * be a frame later than events emitted from the 'engine' context.
+             */
+
+            /** Notes on frames and ticks.
+             * A frame reads input, runs onBeforeFrame, runs the simulation, runs onAfterFrame and publishes render data. The simulation is one or more
+             * ticks: each tick runs the GameLogic systems, onBeforeUpdate and physics, pumps events and runs the Update systems.
+             * In variable-tick mode (simulation/tick-delta = 0), every frame runs exactly one tick. In fixed-tick mode, a frame runs as many ticks as
+             * its time covers, which may be none, so onBeforeUpdate may run several times per frame, or not at all.
+             *  Once per frame: onBeforeFrame and onAfterFrame (passed the frame delta), input capture and render data publishing
+             *  Once per tick:  onBeforeUpdate (passed the tick delta), the GameLogic and Update systems, physics and the event pump
+             * Events become readable after the pump of the tick they were emitted in and stay readable until the next tick's pump. In fixed-tick mode,
+             * onBeforeFrame and onAfterFrame therefore only see the events pumped by the most recent tick, and see them again in frames without ticks,
+             * so logic that must see every event exactly once belongs in systems or onBeforeUpdate. Input events stay readable until a tick has run.
+             * Events that the engine itself acts on (eg engine/exit, engine/set-system-status/...) are collected from every pump and applied at the
+             * start of the next frame.
+             * Timers scheduled with emitEvery count ticks.
              */
         };
 
@@ -110,11 +207,11 @@ namespace gou::api {
         virtual void on_unload () = 0;
         // Dev-mode hot-code reload lifecycle functions.
         virtual void on_before_reload () = 0; // Before hot code reload, use to persist data
-        virtual void on_after_reload () = 0; // After hot code reload, use to reload data
+        virtual void on_after_reload () = 0; // After hot code reload, use to reload data. A reloaded modules old systems are discarded, register systems in onRegisterSystems (called after onLoad and after every reload) so they're registered again
         // Logic hooks. Use these to add custom logic on a per-frame basis.
         virtual void on_before_frame (Time, DeltaTime, uint64_t) = 0;
-        virtual void on_before_update () = 0;
-        virtual void on_after_frame () = 0;
+        virtual void on_before_update (Time, DeltaTime, uint64_t) = 0;
+        virtual void on_after_frame (Time, DeltaTime, uint64_t) = 0;
         // Rendering hooks. Use these to add custom rendering, including dev tool UI.
         virtual void on_prepare_render () = 0;
         virtual void on_before_render () = 0;
@@ -193,9 +290,43 @@ namespace gou::api {
         /** Returns a pointer to a newly created event, that will be accessible next frame */
         virtual events::Event* emit () = 0;
 
+        /** Copy a trivially-copyable payload into this frames payload arena, returning a handle to store in Event::handle (0 on failure) */
+        virtual std::uint32_t emitPayload (const void* data, std::size_t size) = 0;
+
+        /** Access the payload referred to by the handle of an event emitted last frame, nullptr if there is none */
+        virtual const void* payload (std::uint32_t handle) = 0;
+
+        /** Schedule an event to be emitted once engine time reaches 'time' (seconds since startup). Scheduled events can't carry payloads */
+        virtual events::TimerHandle emitAt (Time time, const events::Event& event) = 0;
+
+        /** Schedule an event to be emitted after 'seconds' of engine time */
+        virtual events::TimerHandle emitAfter (DeltaTime seconds, const events::Event& event) = 0;
+
+        /** Schedule an event to be emitted every 'frames' frames (ticks, in fixed-tick mode), until cancelled */
+        virtual events::TimerHandle emitEvery (std::uint32_t frames, const events::Event& event) = 0;
+
+        /** Cancel a scheduled event, ignored if it has already been emitted or cancelled */
+        virtual void cancelTimer (events::TimerHandle) = 0;
+
         /** Access events emitted last frame */
         virtual const detail::EventsIterator& events () = 0;
 
+        /** Access only the events of a specific type emitted last frame */
+        virtual detail::EventChannelIterator events (entt::hashed_string::hash_type) = 0;
+
+        /**
+         * Run fn(userdata, begin, end) over [0, count) in chunks of up to chunk_size, in parallel on the engines workers, returning once
+         * every chunk is done. Unlike the rest of the engine API, this is safe to call from inside a system. Only the first call in each
+         * system run is spread across the workers: a system can only wait on its workers once, so any further calls in the same run
+         * execute serially on the calling thread, as do calls from outside a system. The chunks must not make structural changes to the
+         * registry. Use the helpers in gou.hpp.
+         */
+        using ParallelForFn = void(*)(const void* userdata, std::size_t begin, std::size_t end);
+        virtual void parallelFor (std::size_t count, std::size_t chunk_size, ParallelForFn fn, const void* userdata) = 0;
+
+        /** Per-system timing statistics, in the order the systems were added to the task graph. Safe to call from onPrepareRender */
+        virtual const std::vector<SystemStats>& systemStats () = 0;
+
         /** Access an ECS registry */
         virtual entt::registry& registry (Registry) = 0;
 
@@ -214,6 +345,20 @@ namespace gou::api {
         /** Merge a template into an entity */
         virtual void mergeEntity (entt::entity, entt::hashed_string, bool) = 0;
 
+        /**
+         * Create 'count' entities from a template in bulk, writing them to 'entities' (which must have room for 'count'). Each component is
+         * added to all of the entities at once. If 'init' is set, init(userdata, entity, index) is then called for each new entity, to set
+         * per-instance state such as positions. Returns false, creating nothing, if there is no such template. Use the helpers in gou.hpp.
+         */
+        using LoadEntitiesFn = void(*)(const void* userdata, entt::entity entity, std::size_t index);
+        virtual bool loadEntities (entt::hashed_string, std::size_t count, entt::entity* entities, LoadEntitiesFn init, const void* userdata) = 0;
+
+        /** Write a registry's entities and registered, trivially copyable components to a binary snapshot file. Returns false on failure */
+        virtual bool saveSnapshot (const entt::registry&, const std::string& filename) = 0;
+
+        /** Replace the contents of a registry with a snapshot. Not safe to call from inside a system. Returns false, leaving the registry untouched, on failure */
+        virtual bool loadSnapshot (entt::registry&, const std::string& filename) = 0;
+
         // Get a list of components (note: only available during on_load!)
         virtual const std::vector<definitions::Component>& getRegisteredComponents () = 0;
 
@@ -235,5 +380,24 @@ namespace gou::api {
         gou::events::Event& emitEvent (Engine& engine, Args&&... args) {
             return *new (engine.emit())gou:: events::Event{args...};
         }
+
+        /** Helper function to construct an event that carries a payload to emit in-place. The payload is readable next frame, along with the event */
+        template <typename Payload, typename... Args>
+        gou::events::Event& emitEventWithPayload (Engine& engine, const Payload& payload, Args&&... args) {
+            static_assert(std::is_trivially_copyable_v<Payload>, "Event payloads must be trivially copyable");
+            const std::uint32_t handle = engine.emitPayload(&payload, sizeof(Payload));
+            auto& event = emitEvent(engine, std::forward<Args>(args)...);
+            event.handle = handle;
+            return event;
+        }
+
+        /** Helper function to access the payload of an event, nullptr if it has none */
+        template <typename Payload>
+        const Payload* eventPayload (Engine& engine, const gou::events::Event& event) {
+            if (event.handle == 0) {
+                return nullptr;
+            }
+            return static_cast<const Payload*>(engine.payload(event.handle));
+        }
     }
 }
@@ -3,6 +3,7 @@
 #include <entt/core/utility.hpp>
 #include <entt/entity/poly_storage.hpp>
 #include <cstring>
+#include <vector>
 
 enum OnComponentCollision {
     Replace,
@@ -12,6 +13,13 @@ enum OnComponentCollision {
 template<typename... Type>
 entt::type_list<Type...> as_type_list(const entt::type_list<Type...> &);
 
+/** A callback for PolyStorage::watch. It must stay at the same address for as long as it is connected */
+template<typename Entity>
+struct PolyStorageWatcher {
+    void (*callback)(void* userdata, entt::basic_registry<Entity>& owner, const Entity entity);
+    void* userdata;
+};
+
 template<typename Entity>
 struct PolyStorage: entt::type_list_cat_t<
     decltype(as_type_list(std::declval<entt::Storage<Entity>>())),
@@ -20,7 +28,18 @@ struct PolyStorage: entt::type_list_cat_t<
         const void*(const Entity) const,
         void(entt::basic_registry<Entity> &) const,
         void(entt::basic_registry<Entity> &) const,
-        void(entt::basic_registry<Entity> &) const
+        void(entt::basic_registry<Entity> &) const,
+        void(entt::basic_registry<Entity> &) const,
+        void(entt::basic_registry<Entity> &, std::size_t, std::size_t) const,
+        void(entt::basic_registry<Entity> &) const,
+        void(entt::basic_registry<Entity> &) const,
+        std::size_t() const,
+        bool(std::vector<Entity> &, std::vector<char> &) const,
+        void(entt::basic_registry<Entity> &, const Entity *, const Entity *, const void *) const,
+        void(entt::basic_registry<Entity> &, const Entity *, const Entity *, const void *) const,
+        std::size_t() const,
+        bool() const,
+        void(entt::basic_registry<Entity> &, PolyStorageWatcher<Entity> &) const
     >
 > {
     using entity_type = Entity;
@@ -56,6 +75,68 @@ struct PolyStorage: entt::type_list_cat_t<
                     break;
             }
         }
+
+        /**
+         * Make this component in 'other' match this storage, in two steps. First, sync_structure_to adds it to entities that lack it
+         * and removes it from entities this storage doesn't contain. Then, sync_values_to replaces it where it differs (bytewise, for
+         * trivially copyable types), for the components at positions [begin, end) of this storage. Components that are already
+         * equal are left alone, so no signals fire for them. All entities must already exist in 'other'.
+         * Different ranges of sync_values_to can run in parallel, as they only write to existing components.
+         */
+        void sync_structure_to(entt::basic_registry<Entity>& other) const {
+            entt::poly_call<base + 5>(*this, other);
+        }
+        void sync_values_to(entt::basic_registry<Entity>& other, size_type begin, size_type end) const {
+            entt::poly_call<base + 6>(*this, other, begin, end);
+        }
+
+        /** Remove this component from every entity of 'owner' */
+        void clear(entt::basic_registry<Entity>& owner) const {
+            entt::poly_call<base + 7>(*this, owner);
+        }
+
+        /** Make sure 'other' has a storage for this component, so that different storages can then be written to from different threads */
+        void assure(entt::basic_registry<Entity>& other) const {
+            entt::poly_call<base + 8>(*this, other);
+        }
+
+        /** Number of components in this storage */
+        size_type count() const {
+            return entt::poly_call<base + 9>(*this);
+        }
+
+        /**
+         * Append this storages entities and the raw bytes of their components, packed in the same order, to 'entities' and 'values'.
+         * Returns false (appending nothing) if the component isn't trivially copyable. Empty components append no bytes.
+         */
+        bool pack(std::vector<entity_type>& entities, std::vector<char>& values) const {
+            return entt::poly_call<base + 10>(*this, entities, values);
+        }
+
+        /** Add this component to the entities [first, last) of 'owner' in bulk, from packed values written by pack */
+        void unpack(entt::basic_registry<Entity>& owner, const entity_type* first, const entity_type* last, const void* values) const {
+            entt::poly_call<base + 11>(*this, owner, first, last, values);
+        }
+
+        /** Add a copy of 'instance' (a component from another storage of the same type) to each of the entities [first, last) of 'owner' in bulk */
+        void fill(entt::basic_registry<Entity>& owner, const entity_type* first, const entity_type* last, const void* instance) const {
+            entt::poly_call<base + 12>(*this, owner, first, last, instance);
+        }
+
+        /** Size of one component as packed by pack, 0 for empty components and components that aren't trivially copyable */
+        size_type packed_size() const {
+            return entt::poly_call<base + 13>(*this);
+        }
+
+        /** Whether pack can store this component, that is, whether it is trivially copyable */
+        bool packable() const {
+            return entt::poly_call<base + 14>(*this);
+        }
+
+        /** Call 'watcher' whenever this component is added to, replaced on or removed from an entity of 'owner' */
+        void watch(entt::basic_registry<Entity>& owner, PolyStorageWatcher<Entity>& watcher) const {
+            entt::poly_call<base + 15>(*this, owner, watcher);
+        }
     };
 
     template<typename Type>
@@ -125,6 +206,125 @@ struct PolyStorage: entt::type_list_cat_t<
             }
         }
 
+        static void sync_structure_to(const Type &self, entt::basic_registry<entity_type> &other) {
+            using value_type = typename Type::value_type;
+            const entt::sparse_set &base = self;
+            std::vector<entity_type> stale;
+            for (auto entity : other.template view<value_type>()) {
+                if (! base.contains(entity)) {
+                    stale.push_back(entity);
+                }
+            }
+            other.template remove<value_type>(stale.begin(), stale.end());
+            if constexpr(std::is_empty_v<value_type>) {
+                for (auto& entity : base) {
+                    if (! other.template all_of<value_type>(entity)) {
+                        other.template emplace<value_type>(entity);
+                    }
+                }
+            } else {
+                auto it = self.begin();
+                for (auto& entity : base) {
+                    const auto& value = *it++;
+                    if (! other.template all_of<value_type>(entity)) {
+                        other.template emplace<value_type>(entity, value);
+                    }
+                }
+            }
+        }
+
+        static void sync_values_to(const Type &self, entt::basic_registry<entity_type> &other, size_type begin, size_type end) {
+            using value_type = typename Type::value_type;
+            if constexpr(! std::is_empty_v<value_type>) {
+                const entt::sparse_set &base = self;
+                for (auto index = begin; index < end; ++index) {
+                    const auto entity = base.data()[index];
+                    const auto& value = self.get(entity);
+                    auto& existing = other.template get<value_type>(entity);
+                    if constexpr(std::is_trivially_copyable_v<value_type>) {
+                        if (std::memcmp(&existing, &value, sizeof(value_type)) == 0) {
+                            continue;
+                        }
+                    }
+                    other.template replace<value_type>(entity, value);
+                }
+            }
+        }
+
+        static void clear(const Type &, entt::basic_registry<entity_type> &owner) {
+            owner.template clear<typename Type::value_type>();
+        }
+
+        static void assure(const Type &, entt::basic_registry<entity_type> &other) {
+            static_cast<void>(other.template view<typename Type::value_type>());
+        }
+
+        static size_type count(const Type &self) {
+            const entt::sparse_set &base = self;
+            return base.size();
+        }
+
+        static bool pack(const Type &self, std::vector<entity_type> &entities, std::vector<char> &values) {
+            using value_type = typename Type::value_type;
+            if constexpr(! std::is_trivially_copyable_v<value_type>) {
+                return false;
+            } else {
+                const entt::sparse_set &base = self;
+                entities.insert(entities.end(), base.data(), base.data() + base.size());
+                if constexpr(! std::is_empty_v<value_type>) {
+                    const auto offset = values.size();
+                    values.resize(offset + base.size() * sizeof(value_type));
+                    for (size_type index = 0; index < base.size(); ++index) {
+                        std::memcpy(values.data() + offset + index * sizeof(value_type), &self.get(base.data()[index]), sizeof(value_type));
+                    }
+                }
+                return true;
+            }
+        }
+
+        static void unpack(const Type &, entt::basic_registry<entity_type> &owner, const entity_type *first, const entity_type *last, const void *values) {
+            using value_type = typename Type::value_type;
+            if constexpr(std::is_empty_v<value_type>) {
+                owner.template insert<value_type>(first, last);
+            } else if constexpr(std::is_trivially_copyable_v<value_type>) {
+                owner.template insert<value_type>(first, last, static_cast<const value_type*>(values));
+            }
+        }
+
+        static void fill(const Type &, entt::basic_registry<entity_type> &owner, const entity_type *first, const entity_type *last, const void *instance) {
+            using value_type = typename Type::value_type;
+            if constexpr(std::is_empty_v<value_type>) {
+                owner.template insert<value_type>(first, last);
+            } else {
+                owner.template insert<value_type>(first, last, *static_cast<const value_type*>(instance));
+            }
+        }
+
+        static size_type packed_size(const Type &) {
+            using value_type = typename Type::value_type;
+            if constexpr(std::is_empty_v<value_type> || ! std::is_trivially_copyable_v<value_type>) {
+                return 0;
+            } else {
+                return sizeof(value_type);
+            }
+        }
+
+        static bool packable(const Type &) {
+            return std::is_trivially_copyable_v<typename Type::value_type>;
+        }
+
+        static void notify(PolyStorageWatcher<entity_type> &watcher, entt::basic_registry<entity_type> &owner, const entity_type entity) {
+            watcher.callback(watcher.userdata, owner, entity);
+        }
+
+        static void watch(const Type &, entt::basic_registry<entity_type> &owner, PolyStorageWatcher<entity_type> &watcher) {
+            using value_type = typename Type::value_type;
+            // Connecting disconnects any previous connection of the same watcher first, so watching twice is harmless
+            owner.template on_construct<value_type>().template connect<&members::notify>(watcher);
+            owner.template on_update<value_type>().template connect<&members::notify>(watcher);
+            owner.template on_destroy<value_type>().template connect<&members::notify>(watcher);
+        }
+
     };
 
     template<typename Type>
@@ -135,7 +335,18 @@ struct PolyStorage: entt::type_list_cat_t<
             &members<Type>::get,
             &members<Type>::copy_to,
             &members<Type>::safe_copy_to_overwrite,
-            &members<Type>::safe_copy_to_skip
+            &members<Type>::safe_copy_to_skip,
+            &members<Type>::sync_structure_to,
+            &members<Type>::sync_values_to,
+            &members<Type>::clear,
+            &members<Type>::assure,
+            &members<Type>::count,
+            &members<Type>::pack,
+            &members<Type>::unpack,
+            &members<Type>::fill,
+            &members<Type>::packed_size,
+            &members<Type>::packable,
+            &members<Type>::watch
         >
     >;
 };
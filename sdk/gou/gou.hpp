@@ -5,6 +5,8 @@
 
 #include <components/core.hpp>
 
+#include <deque>
+
 ///////////////////////////////////////////////////////////////////////////////
 // Implementation Details, not part of public API
 ///////////////////////////////////////////////////////////////////////////////
@@ -141,6 +143,28 @@ namespace gou {
             return m_engine.loadEntity(id);
         }
 
+        /*
+         * Create 'count' entities from an entity prototype, writing them to 'entities' (which must have room for 'count')
+         * Much cheaper than calling loadEntity in a loop, as each component is added to all of the entities at once
+         */
+        bool loadEntities (entt::hashed_string id, std::size_t count, entt::entity* entities) {
+            return m_engine.loadEntities(id, count, entities, nullptr, nullptr);
+        }
+
+        /*
+         * Like loadEntities, but then calls fn(entity, index) for each new entity, to set per-instance state such as positions:
+         * scene.loadEntities("projectile"_hs, count, entities, [&](auto entity, auto index){ scene.get<components::Position>(entity) = ...; });
+         */
+        template <typename Fn>
+        bool loadEntities (entt::hashed_string id, std::size_t count, entt::entity* entities, Fn&& fn) {
+            struct Job {
+                Fn& fn;
+            } job{fn};
+            return m_engine.loadEntities(id, count, entities, [](const void* userdata, entt::entity entity, std::size_t index){
+                static_cast<const Job*>(userdata)->fn(entity, index);
+            }, &job);
+        }
+
         /*
          * Merge an entity prototype into an existing entity
          * Any components from the entity that are also in the template will be overwritten with the template ones, unless 'overwrite' is unset
@@ -149,6 +173,23 @@ namespace gou {
             m_engine.mergeEntity(entity, id, overwrite);
         }
 
+        /*
+         * Save every entity of the scene, and their components, to a binary snapshot file
+         * Only components that are trivially copyable are saved. Since they are saved as raw bytes, snapshots are meant for restoring
+         * state within the same run (checkpoints, quick-saves, restarting a level), not as a save game format
+         */
+        bool saveSnapshot (const std::string& filename) {
+            return m_engine.saveSnapshot(m_registry, filename);
+        }
+
+        /*
+         * Replace every entity of the scene with those of a snapshot saved by saveSnapshot
+         * Don't call from inside a system. Entities keep the identifiers they had when the snapshot was saved
+         */
+        bool loadSnapshot (const std::string& filename) {
+            return m_engine.loadSnapshot(m_registry, filename);
+        }
+
         /*
          * Change to a different scene (unloads current scene and loads new one)
          */
@@ -164,11 +205,66 @@ namespace gou {
             return api::helpers::emitEvent(m_engine, std::forward<Args>(args)...);
         }
 
+        /*
+         * Emit an event carrying a trivially-copyable payload of any size, readable next frame through payload<Payload>(event)
+         */
+        template <typename Payload, typename... Args>
+        events::Event& emitWithPayload (const Payload& payload, Args&&... args) {
+            return api::helpers::emitEventWithPayload(m_engine, payload, std::forward<Args>(args)...);
+        }
+
+        /*
+         * Access the payload of an event emitted by the previous frame, nullptr if it has no payload
+         */
+        template <typename Payload>
+        const Payload* payload (const events::Event& event) {
+            return api::helpers::eventPayload<Payload>(m_engine, event);
+        }
+
+        /*
+         * Schedule an event to be emitted once engine time reaches 'time' (see currentTime()). Returns a handle to cancel it with
+         */
+        template <typename... Args>
+        events::TimerHandle emitAt (Time time, Args&&... args) {
+            return m_engine.emitAt(time, events::Event{std::forward<Args>(args)...});
+        }
+
+        /*
+         * Schedule an event to be emitted after 'seconds' of engine time. Returns a handle to cancel it with
+         */
+        template <typename... Args>
+        events::TimerHandle emitAfter (DeltaTime seconds, Args&&... args) {
+            return m_engine.emitAfter(seconds, events::Event{std::forward<Args>(args)...});
+        }
+
+        /*
+         * Schedule an event to be emitted every 'frames' frames (ticks, in fixed-tick mode), until cancelled. Returns a handle to cancel it with
+         */
+        template <typename... Args>
+        events::TimerHandle emitEvery (std::uint32_t frames, Args&&... args) {
+            return m_engine.emitEvery(frames, events::Event{std::forward<Args>(args)...});
+        }
+
+        /*
+         * Cancel a scheduled event
+         */
+        void cancelTimer (events::TimerHandle timer) {
+            m_engine.cancelTimer(timer);
+        }
+
         /*
          * Get an iterator to a read-only iterator to events emitted by the previous frame
          */
-        helpers::ConstIterator<api::detail::EventsIterator> events () {
-            return helpers::const_iterate(m_engine.events());
+        const api::detail::EventsIterator& events () {
+            return m_engine.events();
+        }
+
+        /*
+         * Get a read-only iterator to only the events of a specific type emitted by the previous frame
+         * Use to process a single event type without scanning all events: for (auto& event : scene.events("engine/exit"_event)) ...
+         */
+        api::detail::EventChannelIterator events (entt::hashed_string::hash_type type) {
+            return m_engine.events(type);
         }
 
         /*
@@ -212,11 +308,71 @@ namespace gou {
         gou::api::Engine& m_engine;
     };
 
+    namespace detail {
+        // Entities per chunk, so that a chunks entities and components fit comfortably in a 32KB L1 data cache
+        template <typename... Components>
+        constexpr std::size_t chunkSize () {
+            constexpr std::size_t bytes = sizeof(entt::entity) + (std::size_t{0} + ... + sizeof(std::remove_const_t<Components>));
+            return std::max(std::size_t{32768} / bytes, std::size_t{64});
+        }
+
+        struct ParallelSystemInfo {
+            api::Engine* engine;
+            std::size_t chunk_size;
+        };
+    }
+
+    /*
+     * Call fn(entity, Components&...) for every entity that has all of the Components, split into chunks that run in parallel on the
+     * engines workers. Components that are only read should be const. Safe to call from inside a system, but fn must not add or
+     * remove entities or components and must only write to the components of the entity it was called for.
+     */
+    template <typename... Components, typename Fn>
+    void parallelEach (api::Engine& engine, entt::registry& registry, Fn&& fn, std::size_t chunk_size = detail::chunkSize<Components...>()) {
+        auto view = registry.view<Components...>();
+        // Chunks are taken from the views smallest storage, entities that don't have all the other components are skipped
+        const auto& handle = view.handle();
+        struct Job {
+            decltype(view)& view;
+            const entt::entity* entities;
+            Fn& fn;
+        } job{view, handle.data(), fn};
+        engine.parallelFor(handle.size(), chunk_size, [](const void* userdata, std::size_t begin, std::size_t end){
+            const auto& job = *static_cast<const Job*>(userdata);
+            for (auto index = begin; index < end; ++index) {
+                const auto entity = job.entities[index];
+                if (job.view.contains(entity)) {
+                    job.fn(entity, job.view.template get<Components>(entity)...);
+                }
+            }
+        }, &job);
+    }
+
+    /*
+     * Call fn(entity) for every entity of a group (or anything else with contiguous data() and size()), split into chunks that run
+     * in parallel on the engines workers. The same restrictions as parallelEach apply.
+     */
+    template <typename Group, typename Fn>
+    void parallelEachIn (api::Engine& engine, const Group& group, Fn&& fn, std::size_t chunk_size = detail::chunkSize<>()) {
+        struct Job {
+            const entt::entity* entities;
+            Fn& fn;
+        } job{group.data(), fn};
+        engine.parallelFor(group.size(), chunk_size, [](const void* userdata, std::size_t begin, std::size_t end){
+            const auto& job = *static_cast<const Job*>(userdata);
+            for (auto index = begin; index < end; ++index) {
+                job.fn(job.entities[index]);
+            }
+        }, &job);
+    }
+
     // API for managing engine setup
     class Engine {
     public:
         gou::api::Engine& engine;
         Scene& scene;
+        // Settings of the modules parallel systems, passed to the organizer by pointer so each needs a stable address
+        std::deque<detail::ParallelSystemInfo>& parallel_systems;
 
         /*
          * Read a data file 
@@ -232,6 +388,37 @@ namespace gou {
         events::Event& emit (Args&&... args) {
             return api::helpers::emitEvent(engine, std::forward<Args>(args)...);
         }
+
+        /*
+         * Emit an event carrying a trivially-copyable payload
+         */
+        template <typename Payload, typename... Args>
+        events::Event& emitWithPayload (const Payload& payload, Args&&... args) {
+            return api::helpers::emitEventWithPayload(engine, payload, std::forward<Args>(args)...);
+        }
+
+        /*
+         * Add a data-parallel system that calls Function(entity, Components&...) for every entity with all of the Components, in chunks
+         * spread across the engines workers. Components are declared to the organizer as read-only if const and as written otherwise,
+         * so the system is ordered correctly with respect to other systems. Function must follow the rules of parallelEach.
+         *   engine.addParallelSystem<&move, components::Position, const Velocity>(gou::api::SystemStage::GameLogic, "movement");
+         */
+        template <auto Function, typename... Components>
+        void addParallelSystem (api::SystemStage stage, const char* name, std::size_t chunk_size = detail::chunkSize<Components...>()) {
+            // Each registration gets its own settings, so that the same system can be added to several stages or with different chunk sizes
+            parallel_systems.push_back({&engine, chunk_size});
+            engine.organizer(stage).template emplace<Components...>(+[](const void* payload, entt::registry& registry){
+                const auto& info = *static_cast<const detail::ParallelSystemInfo*>(payload);
+                parallelEach<Components...>(*info.engine, registry, Function, info.chunk_size);
+            }, &parallel_systems.back(), name);
+        }
+
+        /*
+         * Rolling timing statistics (mean, p95, p99, max) of each system
+         */
+        const std::vector<api::SystemStats>& systemStats () {
+            return engine.systemStats();
+        }
     };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -249,6 +436,7 @@ namespace gou {
         HAS_MEMBER_FUNCTION(onUnload,        (std::declval<Engine>()))
         HAS_MEMBER_FUNCTION(onBeforeReload,  (std::declval<Engine>()))
         HAS_MEMBER_FUNCTION(onAfterReload,   (std::declval<Engine>()))
+        HAS_MEMBER_FUNCTION(onRegisterSystems, (std::declval<Engine>()))
         HAS_MEMBER_FUNCTION(onBeforeFrame,   (std::declval<Scene&>()))
         HAS_MEMBER_FUNCTION(onBeforeUpdate,  (std::declval<Scene&>()))
         HAS_MEMBER_FUNCTION(onAfterFrame,    (std::declval<Scene&>()))
@@ -277,6 +465,14 @@ namespace gou {
         return api::helpers::emitEvent(m_engine, std::forward<Args>(args)...);
     }
 
+    /*
+     * Emit an event carrying a trivially-copyable payload
+     */
+    template <typename Payload, typename... Args>
+    events::Event& emitWithPayload (const Payload& payload, Args&&... args) {
+        return api::helpers::emitEventWithPayload(m_engine, payload, std::forward<Args>(args)...);
+    }
+
     /*
      * Logging functions
      */
@@ -297,7 +493,10 @@ namespace gou {
         std::uint32_t on_load () final {
             m_scene.set(0, 0, 0);
             if constexpr (detail::hasMember_onLoad<Derived>()) {
-                static_cast<Derived*>(this)->onLoad(Engine{m_engine, m_scene});
+                static_cast<Derived*>(this)->onLoad(Engine{m_engine, m_scene, m_parallel_systems});
+            }
+            if constexpr (detail::hasMember_onRegisterSystems<Derived>()) {
+                static_cast<Derived*>(this)->onRegisterSystems(Engine{m_engine, m_scene, m_parallel_systems});
             }
 
             uint32_t flags = 0;
@@ -328,19 +527,24 @@ namespace gou {
 
         void on_unload () final {
             if constexpr (detail::hasMember_onUnload<Derived>()) {
-                static_cast<Derived*>(this)->onUnload(Engine{m_engine, m_scene});
+                static_cast<Derived*>(this)->onUnload(Engine{m_engine, m_scene, m_parallel_systems});
             }
         }
 
         void on_before_reload () final {
             if constexpr (detail::hasMember_onBeforeReload<Derived>()) {
-                static_cast<Derived*>(this)->onBeforeReload(Engine{m_engine, m_scene});
+                static_cast<Derived*>(this)->onBeforeReload(Engine{m_engine, m_scene, m_parallel_systems});
             }
         }
 
         void on_after_reload () final {
             if constexpr (detail::hasMember_onAfterReload<Derived>()) {
-                static_cast<Derived*>(this)->onAfterReload(Engine{m_engine, m_scene});
+                static_cast<Derived*>(this)->onAfterReload(Engine{m_engine, m_scene, m_parallel_systems});
+            }
+            // The engine discards a reloaded modules systems, as they point at the old code, so register them again from the new code
+            if constexpr (detail::hasMember_onRegisterSystems<Derived>()) {
+                m_parallel_systems.clear();
+                static_cast<Derived*>(this)->onRegisterSystems(Engine{m_engine, m_scene, m_parallel_systems});
             }
         }
 
@@ -351,13 +555,16 @@ namespace gou {
             }
         }
 
-        void on_before_update () final {
+        void on_before_update (Time time, DeltaTime delta, uint64_t frame) final {
+            // Runs every tick, so the scene has the ticks time rather than the frames
+            m_scene.set(time, delta, frame);
             if constexpr (detail::hasMember_onBeforeUpdate<Derived>()) {
                 static_cast<Derived*>(this)->onBeforeUpdate(m_scene);
             }
         }
 
-        void on_after_frame () final {
+        void on_after_frame (Time time, DeltaTime delta, uint64_t frame) final {
+            m_scene.set(time, delta, frame);
             if constexpr (detail::hasMember_onAfterFrame<Derived>()) {
                 static_cast<Derived*>(this)->onAfterFrame(m_scene);
             }
@@ -365,7 +572,7 @@ namespace gou {
 
         void on_prepare_render () final {
             if constexpr (detail::hasMember_onPrepareRender<Derived>()) {
-                static_cast<Derived*>(this)->onPrepareRender(Engine{m_engine, m_scene});
+                static_cast<Derived*>(this)->onPrepareRender(Engine{m_engine, m_scene, m_parallel_systems});
             }
         }
 
@@ -396,6 +603,7 @@ namespace gou {
 
         const std::string m_moduleName;
         gou::api::Engine& m_engine;
+        std::deque<detail::ParallelSystemInfo> m_parallel_systems; // Owned by the module, as its systems are
         class SettableScene : public Scene {
         public:
             SettableScene (entt::registry& registry, gou::api::Engine& engine) : Scene(registry, engine) {}
@@ -115,9 +115,15 @@ namespace gou {
             entt::entity source;
             glm::vec3 attributes;
             int32_t value;
-            uint32_t handle;
+            uint32_t handle; // Payload handle, if emitted with a payload (0 means no payload)
         }; // 28 bytes (16 events fit in 7 cache lines)
 
+        // Handle to a scheduled event, used to cancel it. A zeroed handle is never valid
+        struct TimerHandle {
+            std::uint32_t id;
+            std::uint32_t generation;
+        };
+
     }
 
 }